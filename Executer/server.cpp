@@ -450,6 +450,12 @@ void Server::handleScriptExecutionResult(QFutureWatcher<PythonResult>* watcher,
 	responseObj["executionTime"] = result.getExecutionTime();
 	responseObj["executionId"] = executionId;
 	responseObj["isScript"] = true;
+	responseObj["errorCode"] = result.getErrorCode();
+	responseObj["queueDepth"] = result.getQueueDepth();
+	responseObj["queueWaitTime"] = result.getQueueWaitTime();
+	if (result.getResourceUsage().available) {
+		responseObj["resourceUsage"] = result.getResourceUsage().toJson();
+	}
 
 	sendResponse(client, responseObj);
 	watcher->deleteLater();
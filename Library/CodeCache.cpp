@@ -0,0 +1,173 @@
+#include "CodeCache.h"
+#include <marshal.h>
+#include <QCryptographicHash>
+#include <vector>
+
+static const char* interpreterLruKey = "EmbedPython.codeCache";
+
+CodeCache::CodeCache(int capacity)
+	: maxEntries(qMax(0, capacity)), hitCount(0), missCount(0), evictionCount(0)
+{
+}
+
+void CodeCache::setCapacity(int capacity)
+{
+	maxEntries.store(qMax(0, capacity)); // Larger LRUs shrink on their next insertion
+}
+
+int CodeCache::capacity() const
+{
+	return maxEntries.load();
+}
+
+qint64 CodeCache::hits() const
+{
+	return hitCount.load();
+}
+
+qint64 CodeCache::misses() const
+{
+	return missCount.load();
+}
+
+qint64 CodeCache::evictions() const
+{
+	return evictionCount.load();
+}
+
+PyObject* CodeCache::get(const QByteArray& source)
+{
+	if (maxEntries.load() == 0) {
+		++missCount;
+		return Py_CompileString(source.constData(), "<string>", Py_file_input);
+	}
+
+	const QByteArray key = QCryptographicHash::hash(source, QCryptographicHash::Sha256);
+	InterpreterLru* lru = interpreterLru();
+
+	if (lru) {
+		std::lock_guard<std::mutex> locker(lru->mutex);
+		auto entry = lru->entries.find(key);
+		if (entry != lru->entries.end()) {
+			lru->order.splice(lru->order.begin(), lru->order, entry.value());
+			++hitCount;
+			return Py_NewRef(entry.value()->second);
+		}
+	}
+
+	// Compiled by another interpreter before: unmarshalling skips tokenizing and compiling
+	QByteArray serialized;
+	{
+		std::lock_guard<std::mutex> locker(marshalled.mutex);
+		auto entry = marshalled.entries.find(key);
+		if (entry != marshalled.entries.end()) {
+			marshalled.order.splice(marshalled.order.begin(), marshalled.order, entry.value());
+			serialized = entry.value()->second;
+		}
+	}
+
+	PyObject* code = nullptr;
+	if (!serialized.isEmpty()) {
+		code = PyMarshal_ReadObjectFromString(serialized.constData(), serialized.size());
+		if (code) {
+			++hitCount;
+		}
+		else {
+			PyErr_Clear();
+		}
+	}
+
+	if (!code) {
+		++missCount;
+		code = Py_CompileString(source.constData(), "<string>", Py_file_input);
+		if (!code)
+			return nullptr;
+
+		PyObject* bytes = PyMarshal_WriteObjectToString(code, Py_MARSHAL_VERSION);
+		if (bytes) {
+			QByteArray value(PyBytes_AS_STRING(bytes), PyBytes_GET_SIZE(bytes));
+			Py_DECREF(bytes);
+
+			std::lock_guard<std::mutex> locker(marshalled.mutex);
+			if (!marshalled.entries.contains(key)) {
+				marshalled.order.emplace_front(key, std::move(value));
+				marshalled.entries.insert(key, marshalled.order.begin());
+			}
+			while (marshalled.order.size() > static_cast<size_t>(maxEntries.load())) {
+				marshalled.entries.remove(marshalled.order.back().first);
+				marshalled.order.pop_back();
+				++evictionCount;
+			}
+		}
+		else {
+			PyErr_Clear();
+		}
+	}
+
+	return lru ? store(lru, key, code) : code;
+}
+
+PyObject* CodeCache::store(InterpreterLru* lru, const QByteArray& key, PyObject* code)
+{
+	std::vector<PyObject*> evicted;
+	{
+		std::lock_guard<std::mutex> locker(lru->mutex);
+		auto entry = lru->entries.find(key);
+		if (entry != lru->entries.end()) {
+			// Another thread of this interpreter got there first; keep the cached object
+			PyObject* cached = Py_NewRef(entry.value()->second);
+			evicted.push_back(code);
+			code = cached;
+		}
+		else {
+			lru->order.emplace_front(key, Py_NewRef(code));
+			lru->entries.insert(key, lru->order.begin());
+		}
+
+		while (lru->order.size() > static_cast<size_t>(maxEntries.load())) {
+			evicted.push_back(lru->order.back().second);
+			lru->entries.remove(lru->order.back().first);
+			lru->order.pop_back();
+		}
+	}
+
+	// Outside the lock, in case releasing a code object runs Python code
+	for (PyObject* object : evicted) {
+		Py_DECREF(object);
+	}
+	return code;
+}
+
+CodeCache::InterpreterLru* CodeCache::interpreterLru()
+{
+	PyObject* interpreterDict = PyInterpreterState_GetDict(PyInterpreterState_Get()); // Borrowed
+	if (!interpreterDict)
+		return nullptr;
+
+	PyObject* capsule = PyDict_GetItemString(interpreterDict, interpreterLruKey); // Borrowed
+	if (!capsule) {
+		// The capsule is released with the interpreter, which still holds its GIL then
+		auto lru = new InterpreterLru();
+		capsule = PyCapsule_New(lru, interpreterLruKey, &CodeCache::releaseInterpreterLru);
+		if (!capsule) {
+			delete lru;
+			PyErr_Clear();
+			return nullptr;
+		}
+		PyDict_SetItemString(interpreterDict, interpreterLruKey, capsule);
+		Py_DECREF(capsule);
+	}
+	return static_cast<InterpreterLru*>(PyCapsule_GetPointer(capsule, interpreterLruKey));
+}
+
+void CodeCache::releaseInterpreterLru(PyObject* capsule)
+{
+	auto lru = static_cast<InterpreterLru*>(PyCapsule_GetPointer(capsule, interpreterLruKey));
+	if (!lru)
+		return;
+
+	for (auto& entry : lru->order) {
+		Py_DECREF(entry.second);
+	}
+	delete lru;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <Python.h>
+#include <QByteArray>
+#include <QHash>
+#include <atomic>
+#include <list>
+#include <mutex>
+
+/**
+ * @brief Bounded LRU of compiled scripts, keyed by a hash of the source.
+ *
+ * Code objects belong to the interpreter that created them, so every interpreter keeps its own LRU of live
+ * code objects in its state dict. Behind those sits one LRU of marshalled code shared by all interpreters:
+ * a script compiled in one sub-interpreter is only unmarshalled, not compiled again, in the others.
+ */
+class CodeCache
+{
+public:
+	/**
+	 * @param capacity Maximum number of scripts per LRU. Use 0 to disable caching.
+	 */
+	explicit CodeCache(int capacity = 256);
+
+	/**
+	 * @brief Returns the code object of source for the current interpreter, compiling it on a miss.
+	 * The caller holds the GIL.
+	 * @return New reference, or nullptr with the SyntaxError set. Failed compilations are not cached.
+	 */
+	PyObject* get(const QByteArray& source);
+
+	void setCapacity(int capacity);
+	int capacity() const;
+
+	qint64 hits() const; // Scripts served without compiling
+	qint64 misses() const; // Scripts that had to be compiled
+	qint64 evictions() const; // Scripts dropped from the shared LRU, which have to be compiled again
+
+private:
+	// Same layout for both levels: most recently used entry at the front
+	template <typename Value>
+	struct Lru {
+		std::list<std::pair<QByteArray, Value>> order;
+		QHash<QByteArray, typename std::list<std::pair<QByteArray, Value>>::iterator> entries;
+		std::mutex mutex; // Free-threaded builds use one interpreter from many threads at once
+	};
+	using InterpreterLru = Lru<PyObject*>;
+
+	std::atomic<int> maxEntries;
+	std::atomic<qint64> hitCount;
+	std::atomic<qint64> missCount;
+	std::atomic<qint64> evictionCount;
+	Lru<QByteArray> marshalled;
+
+	static InterpreterLru* interpreterLru();
+	static void releaseInterpreterLru(PyObject* capsule);
+	PyObject* store(InterpreterLru* lru, const QByteArray& key, PyObject* code);
+};
@@ -1,141 +1,577 @@
-// #include "DataConverter.h"
-// #include <QJsonArray>
-// #include <QJsonObject>
-// #include <QMetaType>
-// #include <QMetaProperty>
-// 
-// 
-// PyObject* DataConverter::QVariantToPyObject(const QVariant& variant) {
-// 	switch (variant.metaType().id()) { // Use metaType().id() instead of type()
-// 	case QMetaType::LongLong:
-// 	case QMetaType::Int:
-// 		return PyLong_FromLong(variant.toInt());
-// 	case QMetaType::Double:
-// 		return PyFloat_FromDouble(variant.toDouble());
-// 	case QMetaType::QString:
-// 		return PyUnicode_FromString(variant.toString().toUtf8().constData());
-// 	case QMetaType::Bool:
-// 		return variant.toBool() ? Py_True : Py_False;
-// 	case QMetaType::QVariantList: {
-// 		PyObject* listObj = PyList_New(0);
-// 		for (const QVariant& item : variant.toList()) {
-// 			PyObject* pyItem = QVariantToPyObject(item);
-// 			if (!pyItem) {
-// 				Py_DECREF(listObj);
-// 				return nullptr;
-// 			}
-// 			PyList_Append(listObj, pyItem);
-// 			Py_DECREF(pyItem);
-// 		}
-// 		return listObj;
-// 	}
-// 
-// 	case QMetaType::QStringList: {
-// 		QStringList list = variant.toStringList();
-// 		PyObject* listObj = PyList_New(list.size());
-// 		if (!listObj) return nullptr;
-// 
-// 		for (int i = 0; i < list.size(); ++i) {
-// 			PyObject* pyItem = PyUnicode_FromString(list[i].toUtf8().constData());
-// 			if (!pyItem) {
-// 				Py_DECREF(listObj);
-// 				return nullptr;
-// 			}
-// 			PyList_SET_ITEM(listObj, i, pyItem);  // Steals reference
-// 		}
-// 		return listObj;
-// 	}
-// 
-// 	case QMetaType::QVariantMap: {
-// 		PyObject* dictObj = PyDict_New();
-// 		QVariantMap map = variant.toMap();
-// 		for (auto it = map.begin(); it != map.end(); ++it) {
-// 			PyObject* key = PyUnicode_FromString(it.key().toUtf8().constData());
-// 			PyObject* value = QVariantToPyObject(it.value());
-// 			if (!key || !value) {
-// 				Py_XDECREF(key);
-// 				Py_XDECREF(value);
-// 				Py_DECREF(dictObj);
-// 				return nullptr;
-// 			}
-// 			PyDict_SetItem(dictObj, key, value);
-// 			Py_DECREF(key);
-// 			Py_DECREF(value);
-// 		}
-// 		return dictObj;
-// 	}
-// 	case QMetaType::QObjectStar: {
-// 		QObject* obj = variant.value<QObject*>();
-// 		if (!obj) {
-// 			Py_INCREF(Py_None);
-// 			return Py_None;
-// 		}
-// 
-// 		// Convert QObject properties to Python dictionary
-// 		PyObject* dictObj = PyDict_New();
-// 		if (!dictObj) return nullptr;
-// 
-// 		const QMetaObject* metaObj = obj->metaObject();
-// 		for (int i = 0; i < metaObj->propertyCount(); ++i) {
-// 			QMetaProperty prop = metaObj->property(i);
-// 			QString propName = prop.name();
-// 			QVariant propValue = obj->property(prop.name());
-// 
-// 			PyObject* key = PyUnicode_FromString(propName.toUtf8().constData());
-// 			PyObject* value = QVariantToPyObject(propValue);
-// 			if (!key || !value) {
-// 				Py_XDECREF(key);
-// 				Py_XDECREF(value);
-// 				Py_DECREF(dictObj);
-// 				return nullptr;
-// 			}
-// 			PyDict_SetItem(dictObj, key, value);
-// 			Py_DECREF(key);
-// 			Py_DECREF(value);
-// 		}
-// 
-// 		return dictObj;
-// 	}
-// 	default:
-// 		break;
-// 	}
-// 	Py_RETURN_NONE; // Return Py_None instead of a nullptr.
-// }
-// 
-// QJsonValue DataConverter::PyObjectToJson(PyObject* obj) {
-// 	if (PyLong_Check(obj)) {
-// 		return QJsonValue(static_cast<qint64>(PyLong_AsLong(obj))); // Explicit cast to resolve ambiguity.
-// 	}
-// 	else if (PyFloat_Check(obj)) {
-// 		return QJsonValue(PyFloat_AsDouble(obj));
-// 	}
-// 	else if (PyUnicode_Check(obj)) {
-// 		return QJsonValue(QString::fromUtf8(PyUnicode_AsUTF8(obj)));
-// 	}
-// 	else if (PyBool_Check(obj)) {
-// 		return QJsonValue(obj == Py_True);
-// 	}
-// 	else if (PyList_Check(obj)) {
-// 		QJsonArray array;
-// 		Py_ssize_t size = PyList_Size(obj);
-// 		for (Py_ssize_t i = 0; i < size; ++i) {
-// 			PyObject* item = PyList_GetItem(obj, i); // Borrowed reference.
-// 			array.append(PyObjectToJson(item));
-// 		}
-// 		return QJsonValue(array);
-// 	}
-// 	else if (PyDict_Check(obj)) {
-// 		QJsonObject jsonObj;
-// 		PyObject* key;
-// 		PyObject* value;
-// 		Py_ssize_t pos = 0;
-// 		while (PyDict_Next(obj, &pos, &key, &value)) {
-// 			if (PyUnicode_Check(key)) {
-// 				QString keyStr = QString::fromUtf8(PyUnicode_AsUTF8(key));
-// 				jsonObj[keyStr] = PyObjectToJson(value);
-// 			}
-// 		}
-// 		return QJsonValue(jsonObj);
-// 	}
-// 	return QJsonValue();
-// }
+#include "DataConverter.h"
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QMetaType>
+#include <QMetaProperty>
+#include <QDateTime>
+#include <QTimeZone>
+#include <QStringList>
+#include <QSysInfo>
+
+// The datetime C API keeps its type pointers in a process-wide static, which is wrong in sub-interpreters,
+// so datetime objects are created and read through the datetime module of the current interpreter.
+static PyObject* datetimeAttribute(const char* name) {
+	PyObject* module = PyImport_ImportModule("datetime");
+	if (!module)
+		return nullptr;
+	PyObject* attribute = PyObject_GetAttrString(module, name);
+	Py_DECREF(module);
+	return attribute;
+}
+
+// Exports the memory of a NumericBuffer through the buffer protocol. The object owns a copy of the buffer, so the
+// memory lives until the last memoryview or numpy array made from it is gone.
+struct BufferOwnerObject {
+	PyObject_HEAD
+	NumericBuffer* buffer;
+	int ndim;
+	Py_ssize_t* shape; // ndim entries each, followed by the strides of a row-major array
+	Py_ssize_t* strides;
+	char format[2];
+};
+
+static int bufferOwnerGetBuffer(PyObject* self, Py_buffer* view, int flags) {
+	BufferOwnerObject* owner = reinterpret_cast<BufferOwnerObject*>(self);
+	if ((flags & PyBUF_WRITABLE) == PyBUF_WRITABLE) {
+		view->obj = nullptr;
+		PyErr_SetString(PyExc_BufferError, "Argument buffers are read-only.");
+		return -1;
+	}
+
+	view->obj = Py_NewRef(self);
+	view->buf = const_cast<void*>(owner->buffer->constData());
+	view->len = owner->buffer->byteSize();
+	view->readonly = 1;
+	view->itemsize = owner->buffer->itemSize();
+	view->format = (flags & PyBUF_FORMAT) == PyBUF_FORMAT ? owner->format : nullptr;
+	// Without PyBUF_ND the consumer gets the flat bytes, which row-major order allows
+	const bool withShape = (flags & PyBUF_ND) == PyBUF_ND;
+	view->ndim = withShape ? owner->ndim : 1;
+	view->shape = withShape ? owner->shape : nullptr;
+	view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? owner->strides : nullptr;
+	view->suboffsets = nullptr;
+	view->internal = nullptr;
+	return 0;
+}
+
+static void bufferOwnerDealloc(PyObject* self) {
+	PyTypeObject* type = Py_TYPE(self);
+	BufferOwnerObject* owner = reinterpret_cast<BufferOwnerObject*>(self);
+	delete owner->buffer;
+	delete[] owner->shape;
+	PyObject_Free(self);
+	Py_DECREF(type); // Instances of heap types own a reference to their type
+}
+
+static PyType_Slot bufferOwnerSlots[] = {
+	{ Py_bf_getbuffer, reinterpret_cast<void*>(bufferOwnerGetBuffer) },
+	{ Py_tp_dealloc, reinterpret_cast<void*>(bufferOwnerDealloc) },
+	{ 0, nullptr }
+};
+
+static PyType_Spec bufferOwnerSpec = {
+	"embedpython.BufferOwner",
+	sizeof(BufferOwnerObject),
+	0,
+	Py_TPFLAGS_DEFAULT | Py_TPFLAGS_DISALLOW_INSTANTIATION,
+	bufferOwnerSlots
+};
+
+/**
+ * @brief Returns a borrowed reference to an entry of the interpreter's state dict, creating it on first use.
+ * @param create Returns a new reference, or nullptr with an exception set.
+ */
+template<typename Create>
+static PyObject* interpreterEntry(const char* key, Create create) {
+	PyObject* interpreterDict = PyInterpreterState_GetDict(PyInterpreterState_Get()); // Borrowed
+	if (!interpreterDict) {
+		PyErr_SetString(PyExc_RuntimeError, "The interpreter has no state dict.");
+		return nullptr;
+	}
+
+	PyObject* entry = PyDict_GetItemString(interpreterDict, key); // Borrowed
+	if (entry)
+		return entry;
+
+	entry = create();
+	if (!entry || PyDict_SetItemString(interpreterDict, key, entry) < 0) {
+		Py_XDECREF(entry);
+		return nullptr;
+	}
+	Py_DECREF(entry);
+	return entry;
+}
+
+static PyObject* bufferToPy(const NumericBuffer& buffer) {
+	// A heap type per interpreter, since sub-interpreters with their own GIL cannot share type objects
+	PyObject* ownerType = interpreterEntry("EmbedPython.BufferOwner", []() { return PyType_FromSpec(&bufferOwnerSpec); });
+	// Looked up once per interpreter; sub-interpreters usually refuse numpy, which leaves None here
+	PyObject* numpy = interpreterEntry("EmbedPython.numpy", []() {
+		PyObject* module = PyImport_ImportModule("numpy");
+		if (!module) {
+			PyErr_Clear();
+			module = Py_NewRef(Py_None);
+		}
+		return module;
+	});
+	if (!ownerType || !numpy)
+		return nullptr;
+
+	BufferOwnerObject* owner = PyObject_New(BufferOwnerObject, reinterpret_cast<PyTypeObject*>(ownerType));
+	if (!owner)
+		return nullptr;
+	owner->buffer = new NumericBuffer(buffer);
+
+	// A shape that does not cover the elements exactly would let readers past the end, so it is dropped
+	QList<qsizetype> shape = buffer.shape();
+	qsizetype elements = 1;
+	for (qsizetype dimension : shape) {
+		elements *= dimension;
+	}
+	if (shape.isEmpty() || elements != buffer.count()) {
+		shape = { buffer.count() };
+	}
+
+	owner->ndim = static_cast<int>(shape.size());
+	owner->shape = new Py_ssize_t[2 * shape.size()];
+	owner->strides = owner->shape + shape.size();
+	Py_ssize_t stride = buffer.itemSize();
+	for (qsizetype i = shape.size() - 1; i >= 0; --i) {
+		owner->shape[i] = shape[i];
+		owner->strides[i] = stride;
+		stride *= shape[i];
+	}
+	owner->format[0] = buffer.format();
+	owner->format[1] = '\0';
+
+	PyObject* ownerObj = reinterpret_cast<PyObject*>(owner);
+	PyObject* result = numpy != Py_None
+		? PyObject_CallMethod(numpy, "asarray", "O", ownerObj)
+		: PyMemoryView_FromObject(ownerObj);
+	Py_DECREF(ownerObj);
+	return result;
+}
+
+static PyObject* stringToPy(const QString& string) {
+	const QByteArray utf8 = string.toUtf8();
+	return PyUnicode_FromStringAndSize(utf8.constData(), utf8.size());
+}
+
+static PyObject* timezoneToPy(const QDateTime& dateTime) {
+	if (dateTime.timeSpec() == Qt::LocalTime)
+		return Py_NewRef(Py_None); // Naive datetimes are local time in Python as well
+
+	PyObject* timezoneClass = datetimeAttribute("timezone");
+	PyObject* timedeltaClass = datetimeAttribute("timedelta");
+	PyObject* offset = timedeltaClass ? PyObject_CallFunction(timedeltaClass, "ii", 0, dateTime.offsetFromUtc()) : nullptr;
+	PyObject* timezone = timezoneClass && offset ? PyObject_CallOneArg(timezoneClass, offset) : nullptr;
+	Py_XDECREF(offset);
+	Py_XDECREF(timedeltaClass);
+	Py_XDECREF(timezoneClass);
+	return timezone;
+}
+
+static PyObject* dateTimeToPy(const QDateTime& dateTime) {
+	if (!dateTime.isValid())
+		return Py_NewRef(Py_None);
+
+	PyObject* datetimeClass = datetimeAttribute("datetime");
+	PyObject* timezone = datetimeClass ? timezoneToPy(dateTime) : nullptr;
+	if (!timezone) {
+		Py_XDECREF(datetimeClass);
+		return nullptr;
+	}
+
+	const QDate date = dateTime.date();
+	const QTime time = dateTime.time();
+	PyObject* result = PyObject_CallFunction(datetimeClass, "iiiiiiiO", date.year(), date.month(), date.day(),
+		time.hour(), time.minute(), time.second(), time.msec() * 1000, timezone);
+	Py_DECREF(timezone);
+	Py_DECREF(datetimeClass);
+	return result;
+}
+
+static PyObject* mapToPy(const QVariantMap& map) {
+	PyObject* dictObj = PyDict_New();
+	if (!dictObj)
+		return nullptr;
+
+	for (auto it = map.cbegin(); it != map.cend(); ++it) {
+		PyObject* key = stringToPy(it.key());
+		PyObject* value = key ? DataConverter::QVariantToPyObject(it.value()) : nullptr;
+		const bool stored = value && PyDict_SetItem(dictObj, key, value) == 0;
+		Py_XDECREF(key);
+		Py_XDECREF(value);
+		if (!stored) {
+			Py_DECREF(dictObj);
+			return nullptr;
+		}
+	}
+	return dictObj;
+}
+
+static PyObject* hashToPy(const QVariantHash& hash) {
+	PyObject* dictObj = PyDict_New();
+	if (!dictObj)
+		return nullptr;
+
+	for (auto it = hash.cbegin(); it != hash.cend(); ++it) {
+		PyObject* key = stringToPy(it.key());
+		PyObject* value = key ? DataConverter::QVariantToPyObject(it.value()) : nullptr;
+		const bool stored = value && PyDict_SetItem(dictObj, key, value) == 0;
+		Py_XDECREF(key);
+		Py_XDECREF(value);
+		if (!stored) {
+			Py_DECREF(dictObj);
+			return nullptr;
+		}
+	}
+	return dictObj;
+}
+
+static PyObject* listToPy(const QVariantList& list) {
+	// Sized up front and filled in place instead of growing through PyList_Append
+	PyObject* listObj = PyList_New(list.size());
+	if (!listObj)
+		return nullptr;
+
+	for (qsizetype i = 0; i < list.size(); ++i) {
+		PyObject* item = DataConverter::QVariantToPyObject(list[i]);
+		if (!item) {
+			Py_DECREF(listObj);
+			return nullptr;
+		}
+		PyList_SET_ITEM(listObj, i, item); // Steals reference
+	}
+	return listObj;
+}
+
+PyObject* DataConverter::QVariantToPyObject(const QVariant& variant) {
+	if (!variant.isValid() || variant.isNull())
+		Py_RETURN_NONE;
+
+	switch (variant.metaType().id()) { // Use metaType().id() instead of type()
+	case QMetaType::Bool:
+		return PyBool_FromLong(variant.toBool());
+	case QMetaType::Char:
+	case QMetaType::SChar:
+	case QMetaType::Short:
+	case QMetaType::Int:
+	case QMetaType::Long:
+	case QMetaType::LongLong:
+		return PyLong_FromLongLong(variant.toLongLong());
+	case QMetaType::UChar:
+	case QMetaType::UShort:
+	case QMetaType::UInt:
+	case QMetaType::ULong:
+	case QMetaType::ULongLong:
+		return PyLong_FromUnsignedLongLong(variant.toULongLong());
+	case QMetaType::Float:
+	case QMetaType::Double:
+		return PyFloat_FromDouble(variant.toDouble());
+	case QMetaType::QString:
+		return stringToPy(variant.toString());
+	case QMetaType::QChar:
+		return stringToPy(QString(variant.toChar()));
+	case QMetaType::QByteArray: {
+		const QByteArray bytes = variant.toByteArray();
+		return PyBytes_FromStringAndSize(bytes.constData(), bytes.size());
+	}
+	case QMetaType::QDateTime:
+		return dateTimeToPy(variant.toDateTime());
+	case QMetaType::QDate: {
+		const QDate date = variant.toDate();
+		PyObject* dateClass = datetimeAttribute("date");
+		PyObject* result = dateClass ? PyObject_CallFunction(dateClass, "iii", date.year(), date.month(), date.day()) : nullptr;
+		Py_XDECREF(dateClass);
+		return result;
+	}
+	case QMetaType::QTime: {
+		const QTime time = variant.toTime();
+		PyObject* timeClass = datetimeAttribute("time");
+		PyObject* result = timeClass
+			? PyObject_CallFunction(timeClass, "iiii", time.hour(), time.minute(), time.second(), time.msec() * 1000)
+			: nullptr;
+		Py_XDECREF(timeClass);
+		return result;
+	}
+	case QMetaType::QVariantList:
+		return listToPy(variant.toList());
+	case QMetaType::QStringList: {
+		const QStringList list = variant.toStringList();
+		PyObject* listObj = PyList_New(list.size());
+		if (!listObj)
+			return nullptr;
+
+		for (qsizetype i = 0; i < list.size(); ++i) {
+			PyObject* item = stringToPy(list[i]);
+			if (!item) {
+				Py_DECREF(listObj);
+				return nullptr;
+			}
+			PyList_SET_ITEM(listObj, i, item); // Steals reference
+		}
+		return listObj;
+	}
+	case QMetaType::QVariantMap:
+		return mapToPy(variant.toMap());
+	case QMetaType::QVariantHash:
+		return hashToPy(variant.toHash());
+	case QMetaType::QJsonValue:
+		return QVariantToPyObject(variant.toJsonValue().toVariant());
+	case QMetaType::QJsonObject:
+		return mapToPy(variant.toJsonObject().toVariantMap());
+	case QMetaType::QJsonArray:
+		return listToPy(variant.toJsonArray().toVariantList());
+	case QMetaType::QJsonDocument:
+		return QVariantToPyObject(variant.toJsonDocument().toVariant());
+	case QMetaType::QObjectStar: {
+		QObject* obj = variant.value<QObject*>();
+		if (!obj)
+			Py_RETURN_NONE;
+
+		// Convert QObject properties to Python dictionary
+		QVariantMap properties;
+		const QMetaObject* metaObj = obj->metaObject();
+		for (int i = 0; i < metaObj->propertyCount(); ++i) {
+			const QMetaProperty prop = metaObj->property(i);
+			properties.insert(QString::fromLatin1(prop.name()), prop.read(obj));
+		}
+		return mapToPy(properties);
+	}
+	default:
+		break;
+	}
+
+	// Numeric lists have no fixed type ID
+	const QMetaType type = variant.metaType();
+	if (type == QMetaType::fromType<NumericBuffer>())
+		return bufferToPy(variant.value<NumericBuffer>());
+	if (type == QMetaType::fromType<QList<double>>())
+		return bufferToPy(NumericBuffer(variant.value<QList<double>>()));
+	if (type == QMetaType::fromType<QList<float>>())
+		return bufferToPy(NumericBuffer(variant.value<QList<float>>()));
+	if (type == QMetaType::fromType<QList<qint32>>())
+		return bufferToPy(NumericBuffer(variant.value<QList<qint32>>()));
+	if (type == QMetaType::fromType<QList<qint64>>())
+		return bufferToPy(NumericBuffer(variant.value<QList<qint64>>()));
+
+	PyErr_Format(PyExc_TypeError, "Cannot convert QVariant of type %s to a Python object.", variant.metaType().name());
+	return nullptr;
+}
+
+static QString pyToString(PyObject* obj) {
+	Py_ssize_t size = 0;
+	const char* utf8 = PyUnicode_AsUTF8AndSize(obj, &size);
+	if (!utf8) {
+		PyErr_Clear();
+		return QString();
+	}
+	return QString::fromUtf8(utf8, size);
+}
+
+static int intAttribute(PyObject* obj, const char* name) {
+	PyObject* value = PyObject_GetAttrString(obj, name);
+	const int result = value ? static_cast<int>(PyLong_AsLong(value)) : 0;
+	Py_XDECREF(value);
+	return result;
+}
+
+static bool isDatetimeInstance(PyObject* obj, const char* className) {
+	PyObject* cls = datetimeAttribute(className);
+	const int matches = cls ? PyObject_IsInstance(obj, cls) : 0;
+	Py_XDECREF(cls);
+	if (matches < 0) {
+		PyErr_Clear();
+	}
+	return matches > 0;
+}
+
+static QTime timeFromPy(PyObject* obj) {
+	return QTime(intAttribute(obj, "hour"), intAttribute(obj, "minute"), intAttribute(obj, "second"),
+		intAttribute(obj, "microsecond") / 1000);
+}
+
+static QDateTime dateTimeFromPy(PyObject* obj) {
+	const QDate date(intAttribute(obj, "year"), intAttribute(obj, "month"), intAttribute(obj, "day"));
+	const QTime time = timeFromPy(obj);
+
+	PyObject* offset = PyObject_CallMethod(obj, "utcoffset", nullptr);
+	if (!offset || offset == Py_None) {
+		Py_XDECREF(offset);
+		PyErr_Clear();
+		return QDateTime(date, time); // Naive, i.e. local time
+	}
+
+	PyObject* seconds = PyObject_CallMethod(offset, "total_seconds", nullptr);
+	const int offsetSeconds = seconds ? static_cast<int>(PyFloat_AsDouble(seconds)) : 0;
+	Py_XDECREF(seconds);
+	Py_DECREF(offset);
+	PyErr_Clear();
+	return QDateTime(date, time, QTimeZone::fromSecondsAheadOfUtc(offsetSeconds));
+}
+
+QVariant DataConverter::PyObjectToQVariant(PyObject* obj) {
+	if (!obj || obj == Py_None)
+		return QVariant();
+
+	// bool is a subclass of int, so it has to be checked first
+	if (PyBool_Check(obj))
+		return QVariant(obj == Py_True);
+
+	if (PyLong_Check(obj)) {
+		int overflow = 0;
+		const long long value = PyLong_AsLongLongAndOverflow(obj, &overflow);
+		if (!overflow)
+			return QVariant(static_cast<qlonglong>(value));
+
+		if (overflow > 0) {
+			const unsigned long long unsignedValue = PyLong_AsUnsignedLongLong(obj);
+			if (!PyErr_Occurred())
+				return QVariant(static_cast<qulonglong>(unsignedValue));
+			PyErr_Clear();
+		}
+		const double approximation = PyLong_AsDouble(obj);
+		PyErr_Clear();
+		return QVariant(approximation);
+	}
+
+	if (PyFloat_Check(obj))
+		return QVariant(PyFloat_AS_DOUBLE(obj));
+
+	if (PyUnicode_Check(obj))
+		return QVariant(pyToString(obj));
+
+	if (PyBytes_Check(obj))
+		return QVariant(QByteArray(PyBytes_AS_STRING(obj), PyBytes_GET_SIZE(obj)));
+
+	if (PyByteArray_Check(obj))
+		return QVariant(QByteArray(PyByteArray_AS_STRING(obj), PyByteArray_GET_SIZE(obj)));
+
+	if (PyList_Check(obj) || PyTuple_Check(obj)) {
+		PyObject* sequence = PySequence_Fast(obj, "expected a sequence"); // Same object for lists and tuples
+		if (!sequence) {
+			PyErr_Clear();
+			return QVariant();
+		}
+		const Py_ssize_t size = PySequence_Fast_GET_SIZE(sequence);
+		PyObject** items = PySequence_Fast_ITEMS(sequence);
+		QVariantList list;
+		list.reserve(size);
+		for (Py_ssize_t i = 0; i < size; ++i) {
+			list.append(PyObjectToQVariant(items[i]));
+		}
+		Py_DECREF(sequence);
+		return QVariant(list);
+	}
+
+	if (PyDict_Check(obj)) {
+		QVariantMap map;
+		PyObject* key;
+		PyObject* value;
+		Py_ssize_t pos = 0;
+		while (PyDict_Next(obj, &pos, &key, &value)) {
+			QString keyString;
+			if (PyUnicode_Check(key)) {
+				keyString = pyToString(key);
+			}
+			else {
+				PyObject* keyText = PyObject_Str(key);
+				keyString = keyText ? pyToString(keyText) : QString();
+				Py_XDECREF(keyText);
+				PyErr_Clear();
+			}
+			map.insert(keyString, PyObjectToQVariant(value));
+		}
+		return QVariant(map);
+	}
+
+	if (PyAnySet_Check(obj)) {
+		QVariantList list;
+		list.reserve(PySet_GET_SIZE(obj));
+		PyObject* iterator = PyObject_GetIter(obj);
+		while (PyObject* item = iterator ? PyIter_Next(iterator) : nullptr) {
+			list.append(PyObjectToQVariant(item));
+			Py_DECREF(item);
+		}
+		Py_XDECREF(iterator);
+		PyErr_Clear();
+		return QVariant(list);
+	}
+
+	// datetime is a subclass of date, so it has to be checked first
+	if (isDatetimeInstance(obj, "datetime"))
+		return QVariant(dateTimeFromPy(obj));
+	if (isDatetimeInstance(obj, "date"))
+		return QVariant(QDate(intAttribute(obj, "year"), intAttribute(obj, "month"), intAttribute(obj, "day")));
+	if (isDatetimeInstance(obj, "time"))
+		return QVariant(timeFromPy(obj));
+
+	PyObject* text = PyObject_Str(obj);
+	const QString string = text ? pyToString(text) : QString();
+	Py_XDECREF(text);
+	PyErr_Clear();
+	return string.isNull() ? QVariant() : QVariant(string);
+}
+
+// Maps a buffer's struct-module format to the NumericBuffer format, or '\0' if there is none
+static char numericFormat(const Py_buffer& view) {
+	const char* format = view.format ? view.format : "B";
+	const bool littleEndian = QSysInfo::ByteOrder == QSysInfo::LittleEndian;
+	if (*format == '@' || *format == '=' || (*format == '<' && littleEndian) || ((*format == '>' || *format == '!') && !littleEndian)) {
+		++format;
+	}
+	if (format[0] == '\0' || format[1] != '\0')
+		return '\0';
+
+	// Integer codes differ in size between platforms, so the item size decides
+	switch (format[0]) {
+	case 'd':
+		return view.itemsize == 8 ? 'd' : '\0';
+	case 'f':
+		return view.itemsize == 4 ? 'f' : '\0';
+	case 'B':
+		return view.itemsize == 1 ? 'B' : '\0'; // Signed 'b' and 'c' are refused rather than reread as unsigned
+	case 'i':
+	case 'l':
+	case 'q':
+	case 'n':
+		return view.itemsize == 4 ? 'i' : view.itemsize == 8 ? 'q' : '\0';
+	default:
+		return '\0';
+	}
+}
+
+std::optional<NumericBuffer> DataConverter::PyObjectToNumericBuffer(PyObject* obj) {
+	Py_buffer view;
+	if (PyObject_GetBuffer(obj, &view, PyBUF_RECORDS_RO) < 0)
+		return std::nullopt;
+
+	const char format = numericFormat(view);
+	if (!format) {
+		PyErr_Format(PyExc_TypeError, "Expected a buffer of float64, float32, int32, int64 or unsigned bytes, not format '%s'.",
+			view.format ? view.format : "B");
+		PyBuffer_Release(&view);
+		return std::nullopt;
+	}
+
+	QList<qsizetype> shape;
+	shape.reserve(view.ndim);
+	for (int i = 0; i < view.ndim; ++i) {
+		shape.append(view.shape[i]);
+	}
+
+	// The object's memory belongs to its interpreter and may only be released under its GIL, so the result cannot
+	// keep referencing it; one copy into memory C++ owns is the cheapest safe hand-over
+	QByteArray storage(view.len, Qt::Uninitialized);
+	const bool copied = PyBuffer_ToContiguous(storage.data(), &view, view.len, 'C') == 0;
+	PyBuffer_Release(&view);
+	if (!copied)
+		return std::nullopt;
+	return NumericBuffer(storage, format, shape);
+}
+
+QJsonValue DataConverter::PyObjectToJson(PyObject* obj) {
+	return QJsonValue::fromVariant(PyObjectToQVariant(obj));
+}
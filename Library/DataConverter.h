@@ -1,12 +1,41 @@
 #pragma once
-// #include <Python.h>
-// #include <QVariant>
-// #include <QJsonValue>
-// 
-// 
-// 
-// class DataConverter {
-// public:
-// 	static PyObject* QVariantToPyObject(const QVariant& variant);
-// 	static QJsonValue PyObjectToJson(PyObject* obj);
-// };
+#include <Python.h>
+#include "global.h"
+#include "NumericBuffer.h"
+#include <QVariant>
+#include <QJsonValue>
+#include <optional>
+
+/**
+ * @brief Converts between QVariant and Python objects without going through text.
+ *
+ * Supported in both directions: null/None, bool, 8- to 64-bit integers, floating point, QString/str,
+ * QByteArray/bytes, QDateTime/datetime, QDate/date, QTime/time, lists, string lists and nested maps.
+ * QVariantHash and QJson values convert to Python like their QVariant counterparts, and QObject* becomes a
+ * dict of its properties. NumericBuffer and lists of double, float, qint32 and qint64 are not copied: they become
+ * read-only numpy arrays over the same memory, or memoryviews if numpy cannot be imported, with the buffer's shape. All functions must be called with the GIL of the interpreter the objects belong to.
+ */
+class LIBRARY_EXPORT DataConverter {
+public:
+	/**
+	 * @return New reference, or nullptr with a Python exception set, e.g. TypeError for unsupported types.
+	 */
+	static PyObject* QVariantToPyObject(const QVariant& variant);
+
+	/**
+	 * @brief Converts obj to the closest QVariant. Tuples and sets become lists, dict keys are converted with str(),
+	 * ints outside 64 bits become doubles, and objects of other types their str() form.
+	 * @param obj Borrowed reference. A failing conversion clears the Python error and yields an invalid QVariant.
+	 */
+	static QVariant PyObjectToQVariant(PyObject* obj);
+
+	/**
+	 * @brief Copies the memory of any object supporting the buffer protocol, e.g. bytes, array.array or a numpy array,
+	 * into a NumericBuffer in one pass. Non-contiguous arrays are gathered in row-major order.
+	 * @return std::nullopt with a TypeError set if obj has no buffer or its elements are not float64, float32,
+	 * int32, int64 or unsigned bytes.
+	 */
+	static std::optional<NumericBuffer> PyObjectToNumericBuffer(PyObject* obj);
+
+	static QJsonValue PyObjectToJson(PyObject* obj);
+};
@@ -0,0 +1,193 @@
+#include "InterpreterPool.h"
+#include <QDebug>
+
+static thread_local InterpreterPool::TaskTiming runningTaskTiming;
+
+InterpreterPool::InterpreterPool(int size, bool ownGil, Task initializer)
+	: stopping(false), isolated(ownGil && ownGilSupported()), queued(0)
+{
+	workers.resize(qMax(1, size));
+
+	// Each worker creates its interpreter on its own thread, since a thread state is bound to the thread that uses it
+	for (Worker& worker : workers) {
+		worker.thread = std::thread(&InterpreterPool::run, this, std::ref(worker), initializer);
+	}
+}
+
+InterpreterPool::~InterpreterPool()
+{
+	{
+		std::lock_guard<std::mutex> locker(mutex);
+		stopping = true;
+	}
+	available.notify_all();
+
+	for (Worker& worker : workers) {
+		if (worker.thread.joinable()) {
+			worker.thread.join();
+		}
+	}
+}
+
+int InterpreterPool::size() const
+{
+	return static_cast<int>(workers.size());
+}
+
+bool InterpreterPool::hasOwnGil() const
+{
+	return isolated;
+}
+
+bool InterpreterPool::ownGilSupported()
+{
+#if PY_VERSION_HEX >= 0x030C0000
+	return true;
+#else
+	return false;
+#endif
+}
+
+InterpreterPool::TaskTiming InterpreterPool::currentTaskTiming()
+{
+	return runningTaskTiming;
+}
+
+InterpreterPool::Stats InterpreterPool::stats()
+{
+	std::lock_guard<std::mutex> locker(mutex);
+	Stats snapshot = counters;
+	snapshot.queueDepth = queued;
+	return snapshot;
+}
+
+void InterpreterPool::enqueue(std::deque<QueuedTask>& queue, Task task)
+{
+	// The caller holds mutex
+	QueuedTask queuedTask;
+	queuedTask.task = std::move(task);
+	queuedTask.queuedAt = Clock::now();
+	queuedTask.queueDepth = queued;
+	queue.push_back(std::move(queuedTask));
+
+	++queued;
+	counters.peakQueueDepth = qMax(counters.peakQueueDepth, queued);
+}
+
+void InterpreterPool::submit(Task task)
+{
+	{
+		std::lock_guard<std::mutex> locker(mutex);
+		enqueue(tasks, std::move(task));
+	}
+	available.notify_one();
+}
+
+void InterpreterPool::submitTo(int worker, Task task)
+{
+	{
+		std::lock_guard<std::mutex> locker(mutex);
+		enqueue(workers[worker].pinned, std::move(task));
+	}
+	available.notify_all(); // Only the owning worker can take it, so wake them all
+}
+
+bool InterpreterPool::startInterpreter(Worker& worker)
+{
+	worker.mainThreadState = PyThreadState_New(PyInterpreterState_Main());
+	PyEval_RestoreThread(worker.mainThreadState);
+
+#if PY_VERSION_HEX >= 0x030C0000
+	if (isolated) {
+		PyInterpreterConfig config = {
+			.use_main_obmalloc = 0,
+			.allow_fork = 0,
+			.allow_exec = 0,
+			.allow_threads = 1,
+			.allow_daemon_threads = 0,
+			.check_multi_interp_extensions = 1,
+			.gil = PyInterpreterConfig_OWN_GIL,
+		};
+
+		// Releases the main GIL and returns holding the new interpreter's own GIL
+		PyThreadState* subThreadState = nullptr;
+		PyStatus status = Py_NewInterpreterFromConfig(&subThreadState, &config);
+		if (!PyStatus_Exception(status)) {
+			worker.threadState = subThreadState;
+			return true;
+		}
+
+		qWarning() << "Failed to create a sub-interpreter:" << (status.err_msg ? status.err_msg : "unknown error")
+			<< "- this worker shares the main interpreter's GIL.";
+		PyEval_RestoreThread(worker.mainThreadState);
+	}
+#endif
+
+	worker.threadState = worker.mainThreadState;
+	return false;
+}
+
+void InterpreterPool::stopInterpreter(Worker& worker)
+{
+	PyEval_RestoreThread(worker.threadState);
+
+	if (worker.threadState != worker.mainThreadState) {
+		// Leaves no thread state current; switch back to the main interpreter to drop ours there
+		Py_EndInterpreter(worker.threadState);
+		PyEval_RestoreThread(worker.mainThreadState);
+	}
+
+	PyThreadState_Clear(worker.mainThreadState);
+	PyThreadState_DeleteCurrent();
+	worker.threadState = worker.mainThreadState = nullptr;
+}
+
+void InterpreterPool::run(Worker& worker, const Task& initializer)
+{
+	startInterpreter(worker);
+	if (initializer) {
+		initializer();
+	}
+	PyEval_SaveThread();
+
+	for (;;) {
+		QueuedTask queuedTask;
+		{
+			std::unique_lock<std::mutex> locker(mutex);
+			available.wait(locker, [this, &worker]() { return stopping || !tasks.empty() || !worker.pinned.empty(); });
+			if (!worker.pinned.empty()) {
+				queuedTask = std::move(worker.pinned.front());
+				worker.pinned.pop_front();
+			}
+			else if (!tasks.empty()) {
+				queuedTask = std::move(tasks.front());
+				tasks.pop_front();
+			}
+			else {
+				break; // Stopping with nothing left to run
+			}
+			--queued;
+		}
+
+		const Clock::time_point dequeuedAt = Clock::now();
+		PyEval_RestoreThread(worker.threadState);
+		const Clock::time_point acquiredAt = Clock::now();
+
+		runningTaskTiming.queueDepth = queuedTask.queueDepth;
+		runningTaskTiming.queueWaitTime = std::chrono::duration_cast<std::chrono::microseconds>(dequeuedAt - queuedTask.queuedAt).count();
+		runningTaskTiming.gilWaitTime = std::chrono::duration_cast<std::chrono::microseconds>(acquiredAt - dequeuedAt).count();
+		{
+			std::lock_guard<std::mutex> locker(mutex);
+			++counters.startedTasks;
+			counters.totalQueueWaitTime += runningTaskTiming.queueWaitTime;
+			counters.totalGilWaitTime += runningTaskTiming.gilWaitTime;
+			counters.maxGilWaitTime = qMax(counters.maxGilWaitTime, runningTaskTiming.gilWaitTime);
+		}
+
+		queuedTask.task();
+		runningTaskTiming = TaskTiming();
+		PyEval_SaveThread();
+	}
+
+	stopInterpreter(worker);
+}
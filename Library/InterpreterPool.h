@@ -0,0 +1,112 @@
+#pragma once
+#include <Python.h>
+#include <QString>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <chrono>
+
+/**
+ * @brief Runs Python tasks on dedicated threads, each bound to an interpreter of its own.
+ *
+ * On Python 3.12+ every thread owns a PEP 684 sub-interpreter created with its own GIL, so CPU-bound
+ * scripts on different threads run in parallel. On older runtimes, or when isolated interpreters are not
+ * wanted, the threads share the main interpreter and its GIL through thread states created up front.
+ *
+ * Tasks run with the thread's interpreter current and its GIL held. Sub-interpreters refuse extension
+ * modules without multi-phase initialization, which then fail to import with an ImportError.
+ *
+ * The pool tracks its queue depth and how long tasks wait in the queue and for the GIL, which shows when
+ * more threads would only add contention.
+ */
+class InterpreterPool
+{
+public:
+	using Task = std::function<void()>;
+
+	/**
+	 * @param size Number of threads and interpreters.
+	 * @param ownGil Use sub-interpreters with their own GIL where the runtime supports them.
+	 * @param initializer Runs once on every interpreter before it takes tasks, e.g. to set up sys.path.
+	 * The main interpreter must be initialized and its GIL released by the calling thread.
+	 */
+	InterpreterPool(int size, bool ownGil, Task initializer);
+	~InterpreterPool();
+
+	InterpreterPool(const InterpreterPool&) = delete;
+	InterpreterPool& operator=(const InterpreterPool&) = delete;
+
+	void submit(Task task);
+
+	/**
+	 * @brief Queues a task for one specific worker, e.g. because it uses objects of that worker's interpreter.
+	 * Pinned tasks of a worker run in submission order, ahead of the shared queue.
+	 * @param worker Index in [0, size()).
+	 */
+	void submitTo(int worker, Task task);
+
+	int size() const;
+
+	/**
+	 * @brief True if the workers run in isolated sub-interpreters, false if they share the main GIL.
+	 */
+	bool hasOwnGil() const;
+
+	static bool ownGilSupported();
+
+	/**
+	 * @brief How the task running on the calling thread got there. Only valid inside a task.
+	 */
+	struct TaskTiming {
+		int queueDepth = 0; // Tasks waiting ahead of it when it was submitted
+		qint64 queueWaitTime = 0; // Microseconds from submission until a worker took it
+		qint64 gilWaitTime = 0; // Microseconds the worker waited for the GIL before running it
+	};
+	static TaskTiming currentTaskTiming();
+
+	struct Stats {
+		int queueDepth = 0; // Tasks submitted but not yet taken by a worker
+		int peakQueueDepth = 0;
+		qint64 startedTasks = 0;
+		qint64 totalQueueWaitTime = 0; // Microseconds
+		qint64 totalGilWaitTime = 0; // Microseconds
+		qint64 maxGilWaitTime = 0; // Microseconds
+	};
+	Stats stats();
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	struct QueuedTask {
+		Task task;
+		Clock::time_point queuedAt;
+		int queueDepth = 0;
+	};
+
+	struct Worker {
+		std::thread thread;
+		PyThreadState* mainThreadState = nullptr; // Thread state in the main interpreter, used to create and end the sub-interpreter
+		PyThreadState* threadState = nullptr; // The state tasks run under
+		std::deque<QueuedTask> pinned; // Tasks only this worker may run
+	};
+
+	std::vector<Worker> workers;
+	std::deque<QueuedTask> tasks;
+	std::mutex mutex;
+	std::condition_variable available;
+	bool stopping;
+	bool isolated;
+
+	// Guarded by mutex
+	int queued;
+	Stats counters;
+
+	void enqueue(std::deque<QueuedTask>& queue, Task task);
+
+	void run(Worker& worker, const Task& initializer);
+	bool startInterpreter(Worker& worker);
+	void stopInterpreter(Worker& worker);
+};
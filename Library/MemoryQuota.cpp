@@ -0,0 +1,226 @@
+#include "MemoryQuota.h"
+#include <atomic>
+#include <cstdint>
+
+namespace {
+
+// Precedes every block handed out while the hooks are installed; 16 bytes keep pymalloc's alignment
+struct alignas(16) BlockHeader {
+	size_t size;
+	MemoryQuota::Ledger* ledger; // Ledger the block was charged to, holding one of its references; null for none
+};
+static_assert(sizeof(BlockHeader) == 16, "BlockHeader must preserve 16-byte alignment");
+
+struct Domain {
+	PyMemAllocatorEx wrapped; // The allocator the hook forwards to
+};
+
+Domain memDomain;
+Domain objDomain;
+bool installed = false;
+thread_local MemoryQuota* currentQuota = nullptr;
+
+BlockHeader* headerOf(void* block)
+{
+	return reinterpret_cast<BlockHeader*>(static_cast<char*>(block) - sizeof(BlockHeader));
+}
+
+void* finishBlock(void* base, size_t size, MemoryQuota* quota)
+{
+	BlockHeader* header = static_cast<BlockHeader*>(base);
+	header->size = size;
+	header->ledger = quota ? quota->ledger() : nullptr;
+	if (header->ledger) {
+		header->ledger->references.fetch_add(1, std::memory_order_relaxed);
+	}
+	return header + 1;
+}
+
+void* quotaMalloc(void* ctx, size_t size)
+{
+	Domain* domain = static_cast<Domain*>(ctx);
+	MemoryQuota* quota = currentQuota;
+	if (size > PY_SSIZE_T_MAX - sizeof(BlockHeader) || (quota && !quota->charge(static_cast<qint64>(size))))
+		return nullptr;
+
+	void* base = domain->wrapped.malloc(domain->wrapped.ctx, size + sizeof(BlockHeader));
+	if (!base) {
+		if (quota)
+			quota->release(static_cast<qint64>(size));
+		return nullptr;
+	}
+	return finishBlock(base, size, quota);
+}
+
+void* quotaCalloc(void* ctx, size_t count, size_t elementSize)
+{
+	Domain* domain = static_cast<Domain*>(ctx);
+	if (elementSize != 0 && count > (PY_SSIZE_T_MAX - sizeof(BlockHeader)) / elementSize)
+		return nullptr;
+
+	const size_t size = count * elementSize;
+	MemoryQuota* quota = currentQuota;
+	if (quota && !quota->charge(static_cast<qint64>(size)))
+		return nullptr;
+
+	void* base = domain->wrapped.calloc(domain->wrapped.ctx, 1, size + sizeof(BlockHeader));
+	if (!base) {
+		if (quota)
+			quota->release(static_cast<qint64>(size));
+		return nullptr;
+	}
+	return finishBlock(base, size, quota);
+}
+
+void* quotaRealloc(void* ctx, void* block, size_t size)
+{
+	if (!block)
+		return quotaMalloc(ctx, size);
+	if (size > PY_SSIZE_T_MAX - sizeof(BlockHeader))
+		return nullptr;
+
+	Domain* domain = static_cast<Domain*>(ctx);
+	BlockHeader* header = headerOf(block);
+	MemoryQuota* quota = currentQuota;
+
+	// A block charged to this quota only costs the difference; any other block moves over to it
+	const qint64 oldSize = static_cast<qint64>(header->size);
+	MemoryQuota::Ledger* oldLedger = header->ledger;
+	const bool sameQuota = quota && oldLedger == quota->ledger();
+	const qint64 delta = static_cast<qint64>(size) - (sameQuota ? oldSize : 0);
+	if (quota && !quota->charge(delta))
+		return nullptr;
+
+	void* base = domain->wrapped.realloc(domain->wrapped.ctx, header, size + sizeof(BlockHeader));
+	if (!base) {
+		if (quota)
+			quota->release(delta);
+		return nullptr;
+	}
+
+	header = static_cast<BlockHeader*>(base);
+	header->size = size;
+	if (sameQuota) {
+		return header + 1; // Keeps the reference it already holds
+	}
+	if (oldLedger) {
+		MemoryQuota::releaseBlock(oldLedger, oldSize);
+	}
+	return finishBlock(base, size, quota);
+}
+
+void quotaFree(void* ctx, void* block)
+{
+	if (!block)
+		return;
+
+	Domain* domain = static_cast<Domain*>(ctx);
+	BlockHeader* header = headerOf(block);
+	if (header->ledger) {
+		MemoryQuota::releaseBlock(header->ledger, static_cast<qint64>(header->size));
+	}
+	domain->wrapped.free(domain->wrapped.ctx, header);
+}
+
+void hookDomain(PyMemAllocatorDomain domainId, Domain& domain)
+{
+	PyMem_GetAllocator(domainId, &domain.wrapped);
+	PyMemAllocatorEx hook = { &domain, quotaMalloc, quotaCalloc, quotaRealloc, quotaFree };
+	PyMem_SetAllocator(domainId, &hook);
+}
+
+}
+
+bool MemoryQuota::install()
+{
+#ifdef Py_GIL_DISABLED
+	return false;
+#else
+	if (installed)
+		return true;
+	if (Py_IsInitialized())
+		return false; // Blocks already handed out carry no header
+
+	hookDomain(PYMEM_DOMAIN_MEM, memDomain);
+	hookDomain(PYMEM_DOMAIN_OBJ, objDomain);
+	installed = true;
+	return true;
+#endif
+}
+
+bool MemoryQuota::isInstalled()
+{
+	return installed;
+}
+
+MemoryQuota::MemoryQuota(qint64 limit)
+	: limit(limit), account(new Ledger), peakUsed(0), refused(false), active(false), previous(nullptr)
+{
+}
+
+MemoryQuota::~MemoryQuota()
+{
+	deactivate();
+	releaseBlock(account, 0); // Drops the quota's own reference
+}
+
+void MemoryQuota::activate()
+{
+	if (active)
+		return;
+	previous = currentQuota;
+	currentQuota = this;
+	active = true;
+}
+
+void MemoryQuota::deactivate()
+{
+	if (!active)
+		return;
+	currentQuota = previous;
+	previous = nullptr;
+	active = false;
+}
+
+qint64 MemoryQuota::byteLimit() const
+{
+	return limit;
+}
+
+qint64 MemoryQuota::peak() const
+{
+	return peakUsed;
+}
+
+bool MemoryQuota::limitHit() const
+{
+	return refused;
+}
+
+bool MemoryQuota::charge(qint64 bytes)
+{
+	if (bytes > 0 && limit >= 0 && account->used.load() + bytes > limit) {
+		refused = true;
+		return false;
+	}
+	peakUsed = qMax(peakUsed, account->used.fetch_add(bytes) + bytes);
+	return true;
+}
+
+void MemoryQuota::release(qint64 bytes)
+{
+	account->used.fetch_sub(bytes);
+}
+
+MemoryQuota::Ledger* MemoryQuota::ledger() const
+{
+	return account;
+}
+
+void MemoryQuota::releaseBlock(Ledger* ledger, qint64 bytes)
+{
+	ledger->used.fetch_sub(bytes);
+	if (ledger->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		delete ledger;
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <Python.h>
+#include <QtGlobal>
+#include <atomic>
+
+/**
+ * @brief Byte budget for the Python allocations of one execution.
+ *
+ * install() wraps the PYMEM_DOMAIN_MEM and PYMEM_DOMAIN_OBJ allocators with hooks that prefix every block
+ * with its size and the ledger of the quota it was charged to. While a quota is active on a thread, allocations
+ * on that thread are charged to it, and the hooks fail an allocation that would exceed the limit. Python turns
+ * that failure into a MemoryError in the running script. Other threads are not affected.
+ *
+ * The raw domain is left alone: it is already in use before the hooks can be installed, so its blocks
+ * could not be told apart. Python uses it for few allocations of its own.
+ */
+class MemoryQuota
+{
+public:
+	/**
+	 * @brief Installs the allocator hooks. Has to run after Py_PreInitialize() and before Py_Initialize().
+	 * @return False on free-threaded builds, where objects have to come from mimalloc.
+	 */
+	static bool install();
+	static bool isInstalled();
+
+	/**
+	 * @param limit Maximum number of bytes outstanding at once. Use -1 to only measure.
+	 */
+	explicit MemoryQuota(qint64 limit = -1);
+	~MemoryQuota();
+
+	MemoryQuota(const MemoryQuota&) = delete;
+	MemoryQuota& operator=(const MemoryQuota&) = delete;
+
+	/**
+	 * @brief Charges allocations of the calling thread to this quota until deactivate().
+	 */
+	void activate();
+	void deactivate();
+
+	qint64 byteLimit() const;
+	qint64 peak() const; // Highest number of bytes outstanding while active
+	bool limitHit() const; // An allocation was refused
+
+	/**
+	 * @brief Bytes outstanding for one quota. The quota and every block charged to it hold a reference,
+	 * so a block freed on another thread or after its execution returns its bytes without any lookup.
+	 */
+	struct Ledger {
+		std::atomic<qint64> used{ 0 };
+		std::atomic<qint64> references{ 1 };
+	};
+
+	// Used by the allocator hooks; charge() and release() only on the owning thread
+	bool charge(qint64 bytes);
+	void release(qint64 bytes); // Undoes a charge whose allocation failed
+	Ledger* ledger() const;
+	static void releaseBlock(Ledger* ledger, qint64 bytes); // From any thread, drops the block's reference
+
+private:
+	qint64 limit;
+	Ledger* account; // Outlives the quota while blocks charged to it are alive
+	qint64 peakUsed;
+	bool refused;
+	bool active;
+	MemoryQuota* previous; // Quota active on this thread before activate()
+};
@@ -0,0 +1,101 @@
+#include "NumericBuffer.h"
+
+template<typename Container>
+NumericBuffer NumericBuffer::share(const Container& container, char format)
+{
+	// The copy only takes a reference on the container's data, and constData() does not detach it
+	auto shared = std::make_shared<const Container>(container);
+	NumericBuffer buffer;
+	buffer.pointer = shared->constData();
+	buffer.elements = shared->size();
+	buffer.typeCode = format;
+	buffer.owner = std::move(shared);
+	return buffer;
+}
+
+NumericBuffer::NumericBuffer()
+	: pointer(nullptr), elements(0), typeCode('B')
+{
+}
+
+NumericBuffer::NumericBuffer(const QList<double>& values)
+	: NumericBuffer(share(values, 'd'))
+{
+}
+
+NumericBuffer::NumericBuffer(const QList<float>& values)
+	: NumericBuffer(share(values, 'f'))
+{
+}
+
+NumericBuffer::NumericBuffer(const QList<qint32>& values)
+	: NumericBuffer(share(values, 'i'))
+{
+}
+
+NumericBuffer::NumericBuffer(const QList<qint64>& values)
+	: NumericBuffer(share(values, 'q'))
+{
+}
+
+NumericBuffer::NumericBuffer(const QByteArray& bytes)
+	: NumericBuffer(bytes, 'B')
+{
+}
+
+NumericBuffer::NumericBuffer(const QByteArray& storage, char format, const QList<qsizetype>& shape)
+	: storage(storage), pointer(this->storage.constData()), dimensions(shape), typeCode(format)
+{
+	elements = this->storage.size() / itemSize();
+}
+
+char NumericBuffer::format() const
+{
+	return typeCode;
+}
+
+qsizetype NumericBuffer::itemSize() const
+{
+	switch (typeCode) {
+	case 'd':
+	case 'q':
+		return 8;
+	case 'f':
+	case 'i':
+		return 4;
+	default:
+		return 1;
+	}
+}
+
+qsizetype NumericBuffer::count() const
+{
+	return elements;
+}
+
+qsizetype NumericBuffer::byteSize() const
+{
+	return elements * itemSize();
+}
+
+bool NumericBuffer::isEmpty() const
+{
+	return elements == 0;
+}
+
+QList<qsizetype> NumericBuffer::shape() const
+{
+	return dimensions.isEmpty() ? QList<qsizetype>{ elements } : dimensions;
+}
+
+QByteArray NumericBuffer::toByteArray() const
+{
+	if (!storage.isNull())
+		return storage;
+	return QByteArray(static_cast<const char*>(pointer), byteSize());
+}
+
+const void* NumericBuffer::constData() const
+{
+	return pointer;
+}
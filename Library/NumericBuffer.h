@@ -0,0 +1,87 @@
+#pragma once
+#include "global.h"
+#include <QByteArray>
+#include <QList>
+#include <QMetaType>
+#include <memory>
+#include <type_traits>
+
+/**
+ * @brief Contiguous array of numbers passed between C++ and scripts without formatting it as text.
+ *
+ * As an argument, the buffer shares the memory of the container it was made from, which stays alive for as
+ * long as the buffer or a script still references it. Scripts see it read-only through the buffer protocol,
+ * as a numpy array where numpy is importable and as a memoryview otherwise. Since Qt containers copy on
+ * write, changing the original container afterwards never changes what a script sees.
+ *
+ * As a result, see PythonResult::getResultBuffer(), it holds the elements in row-major order together with
+ * the shape of the array the script returned.
+ */
+class LIBRARY_EXPORT NumericBuffer
+{
+public:
+	NumericBuffer();
+	NumericBuffer(const QList<double>& values);
+	NumericBuffer(const QList<float>& values);
+	NumericBuffer(const QList<qint32>& values);
+	NumericBuffer(const QList<qint64>& values);
+	NumericBuffer(const QByteArray& bytes); // Unsigned bytes
+
+	/**
+	 * @brief Interprets storage as elements of the given format without copying it.
+	 * @param shape Dimensions in row-major order; empty for a one-dimensional buffer.
+	 */
+	NumericBuffer(const QByteArray& storage, char format, const QList<qsizetype>& shape = {});
+
+	/**
+	 * @brief Element type as a struct module format character: 'd', 'f', 'i', 'q' or 'B'.
+	 */
+	char format() const;
+	qsizetype itemSize() const;
+	qsizetype count() const;
+	qsizetype byteSize() const;
+	bool isEmpty() const;
+
+	/**
+	 * @brief Dimensions of the array, {count()} for a one-dimensional buffer.
+	 */
+	QList<qsizetype> shape() const;
+
+	const void* constData() const;
+
+	/**
+	 * @brief The raw bytes. Shares the memory of buffers made from a QByteArray, e.g. results, and copies otherwise.
+	 */
+	QByteArray toByteArray() const;
+
+	/**
+	 * @return The elements, or nullptr if T does not match format().
+	 */
+	template<typename T>
+	const T* data() const {
+		return format() == formatOf<T>() ? static_cast<const T*>(pointer) : nullptr;
+	}
+
+private:
+	std::shared_ptr<const void> owner; // Keeps the memory of a list alive
+	QByteArray storage; // Memory of byte-backed buffers
+	const void* pointer;
+	QList<qsizetype> dimensions;
+	qsizetype elements;
+	char typeCode;
+
+	template<typename T>
+	static constexpr char formatOf() {
+		if constexpr (std::is_same_v<T, double>) return 'd';
+		else if constexpr (std::is_same_v<T, float>) return 'f';
+		else if constexpr (std::is_same_v<T, qint32>) return 'i';
+		else if constexpr (std::is_same_v<T, qint64>) return 'q';
+		else if constexpr (std::is_same_v<T, quint8>) return 'B';
+		else return '\0';
+	}
+
+	template<typename Container>
+	static NumericBuffer share(const Container& container, char format);
+};
+
+Q_DECLARE_METATYPE(NumericBuffer)
@@ -0,0 +1,85 @@
+#include "OutputSpool.h"
+#include <QTemporaryFile>
+#include <QStringDecoder>
+#include <QDir>
+#include <QDebug>
+
+OutputSpool::OutputSpool(qint64 memoryLimit)
+	: memoryLimit(memoryLimit), totalSize(0)
+{
+}
+
+void OutputSpool::append(const char* data, qsizetype size)
+{
+	if (size <= 0)
+		return;
+
+	totalSize += size;
+
+	if (spillFile) {
+		spillFile->write(data, size);
+		return;
+	}
+
+	if (memoryLimit < 0 || buffer.size() + size <= memoryLimit) {
+		buffer.append(data, size);
+		return;
+	}
+
+	if (!spill()) {
+		// Keeping the output is preferable to losing it when no temporary file can be created
+		buffer.append(data, size);
+		return;
+	}
+
+	spillFile->write(data, size);
+
+	// Top the preview up to the cap; the rest only lives in the file
+	const qsizetype previewBytes = qMin<qint64>(size, memoryLimit - buffer.size());
+	if (previewBytes > 0) {
+		buffer.append(data, previewBytes);
+	}
+}
+
+void OutputSpool::append(const QByteArray& chunk)
+{
+	append(chunk.constData(), chunk.size());
+}
+
+qint64 OutputSpool::size() const
+{
+	return totalSize;
+}
+
+bool OutputSpool::isSpilled() const
+{
+	return spillFile != nullptr;
+}
+
+QString OutputSpool::text() const
+{
+	// A stateful decoder holds back an incomplete trailing sequence instead of emitting U+FFFD
+	QStringDecoder decoder(QStringDecoder::Utf8);
+	return decoder(buffer);
+}
+
+std::shared_ptr<QTemporaryFile> OutputSpool::file() const
+{
+	if (spillFile) {
+		spillFile->flush();
+	}
+	return spillFile;
+}
+
+bool OutputSpool::spill()
+{
+	auto file = std::make_shared<QTemporaryFile>(QDir::temp().filePath("EmbedPython-XXXXXX.out"));
+	if (!file->open()) {
+		qWarning() << "Failed to create spill file for script output:" << file->errorString();
+		return false;
+	}
+
+	file->write(buffer);
+	spillFile = file;
+	return true;
+}
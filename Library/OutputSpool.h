@@ -0,0 +1,49 @@
+#pragma once
+#include "global.h"
+#include <QByteArray>
+#include <QString>
+#include <memory>
+
+class QTemporaryFile;
+
+/**
+ * @brief Collects script output in memory up to a cap and spills everything beyond it to a temporary file.
+ *
+ * The in-memory part doubles as the preview of a spilled stream. Once spilled, the file holds the complete
+ * output and memory use stays at the cap no matter how much the script prints.
+ */
+class LIBRARY_EXPORT OutputSpool
+{
+public:
+	/**
+	 * @param memoryLimit Maximum number of bytes kept in memory. Use -1 for no limit.
+	 */
+	explicit OutputSpool(qint64 memoryLimit = -1);
+
+	void append(const char* data, qsizetype size);
+	void append(const QByteArray& chunk);
+
+	/**
+	 * @brief Total number of bytes appended, including the spilled part.
+	 */
+	qint64 size() const;
+	bool isSpilled() const;
+
+	/**
+	 * @brief Decodes the in-memory part. A multi-byte sequence cut off by the cap is dropped.
+	 */
+	QString text() const;
+
+	/**
+	 * @brief The file holding the complete output, or nullptr if the output fit into memory.
+	 */
+	std::shared_ptr<QTemporaryFile> file() const;
+
+private:
+	qint64 memoryLimit;
+	qint64 totalSize;
+	QByteArray buffer;
+	std::shared_ptr<QTemporaryFile> spillFile;
+
+	bool spill();
+};
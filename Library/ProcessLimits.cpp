@@ -0,0 +1,152 @@
+#include "ProcessLimits.h"
+#include <QDir>
+#include <QFile>
+#include <QDebug>
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#endif
+
+bool ExecutionLimits::isEmpty() const
+{
+	return memoryBytes <= 0 && cpuSeconds <= 0 && maxOpenFiles <= 0;
+}
+
+ProcessLimits::ProcessLimits(const ExecutionLimits& limits, const QString& cgroupRoot, const QString& name)
+	: executionLimits(limits), cgroupProcsFd(-1)
+{
+#ifdef Q_OS_UNIX
+	if (!cgroupRoot.isEmpty() && !createCgroup(cgroupRoot, name)) {
+		qWarning() << "Falling back to rlimits, could not create cgroup under" << cgroupRoot;
+	}
+#else
+	Q_UNUSED(cgroupRoot);
+	Q_UNUSED(name);
+	if (!limits.isEmpty()) {
+		qWarning() << "Execution limits are not supported on this platform.";
+	}
+#endif
+}
+
+ProcessLimits::~ProcessLimits()
+{
+#ifdef Q_OS_UNIX
+	if (cgroupProcsFd != -1) {
+		::close(cgroupProcsFd);
+	}
+	if (!cgroupPath.isEmpty() && !QDir().rmdir(cgroupPath)) {
+		// Still populated by processes the script left behind
+		qWarning() << "Failed to remove cgroup" << cgroupPath;
+	}
+#endif
+}
+
+const ExecutionLimits& ProcessLimits::limits() const
+{
+	return executionLimits;
+}
+
+bool ProcessLimits::usesCgroup() const
+{
+	return cgroupProcsFd != -1;
+}
+
+bool ProcessLimits::writeCgroupFile(const QString& file, const QByteArray& value) const
+{
+	QFile control(QDir(cgroupPath).filePath(file));
+	return control.open(QIODevice::WriteOnly) && control.write(value) == value.size();
+}
+
+bool ProcessLimits::createCgroup(const QString& cgroupRoot, const QString& name)
+{
+#ifdef Q_OS_UNIX
+	QDir root(cgroupRoot);
+	if (!root.mkdir(name))
+		return false;
+	cgroupPath = root.filePath(name);
+
+	// The memory controller must be enabled in the root's cgroup.subtree_control for memory.max to exist
+	if (executionLimits.memoryBytes > 0 && !writeCgroupFile("memory.max", QByteArray::number(executionLimits.memoryBytes))) {
+		QDir().rmdir(cgroupPath);
+		cgroupPath.clear();
+		return false;
+	}
+	if (executionLimits.memoryBytes > 0) {
+		writeCgroupFile("memory.swap.max", "0"); // Otherwise the limit only moves the overflow into swap
+	}
+
+	cgroupProcsFd = ::open(QFile::encodeName(QDir(cgroupPath).filePath("cgroup.procs")).constData(), O_WRONLY | O_CLOEXEC);
+	if (cgroupProcsFd == -1) {
+		QDir().rmdir(cgroupPath);
+		cgroupPath.clear();
+		return false;
+	}
+	return true;
+#else
+	Q_UNUSED(cgroupRoot);
+	Q_UNUSED(name);
+	return false;
+#endif
+}
+
+void ProcessLimits::applyInChild() const
+{
+#ifdef Q_OS_UNIX
+	if (cgroupProcsFd != -1) {
+		// "0" moves the writing process
+		[[maybe_unused]] ssize_t written = ::write(cgroupProcsFd, "0", 1);
+	}
+
+	struct rlimit limit;
+	if (executionLimits.memoryBytes > 0 && cgroupProcsFd == -1) {
+		limit.rlim_cur = limit.rlim_max = static_cast<rlim_t>(executionLimits.memoryBytes);
+		::setrlimit(RLIMIT_AS, &limit);
+	}
+	if (executionLimits.cpuSeconds > 0) {
+		// SIGXCPU at the soft limit; the hard limit a second later is the SIGKILL backstop
+		limit.rlim_cur = static_cast<rlim_t>(executionLimits.cpuSeconds);
+		limit.rlim_max = static_cast<rlim_t>(executionLimits.cpuSeconds) + 1;
+		::setrlimit(RLIMIT_CPU, &limit);
+	}
+	if (executionLimits.maxOpenFiles > 0) {
+		limit.rlim_cur = limit.rlim_max = static_cast<rlim_t>(executionLimits.maxOpenFiles);
+		::setrlimit(RLIMIT_NOFILE, &limit);
+	}
+#endif
+}
+
+bool ProcessLimits::cgroupMemoryLimitHit() const
+{
+	if (cgroupPath.isEmpty())
+		return false;
+
+	QFile events(QDir(cgroupPath).filePath("memory.events"));
+	if (!events.open(QIODevice::ReadOnly))
+		return false;
+
+	for (const QByteArray& line : events.readAll().split('\n')) {
+		if (line.startsWith("oom_kill ")) {
+			return line.mid(9).trimmed().toLongLong() > 0;
+		}
+	}
+	return false;
+}
+
+qint64 ProcessLimits::cgroupCpuTime() const
+{
+	if (cgroupPath.isEmpty())
+		return -1;
+
+	// cpu.stat is there without the cpu controller enabled; usage_usec is part of its core statistics
+	QFile stat(QDir(cgroupPath).filePath("cpu.stat"));
+	if (!stat.open(QIODevice::ReadOnly))
+		return -1;
+
+	for (const QByteArray& line : stat.readAll().split('\n')) {
+		if (line.startsWith("usage_usec ")) {
+			return line.mid(11).trimmed().toLongLong();
+		}
+	}
+	return -1;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include "global.h"
+#include <QString>
+
+/**
+ * @brief Resource limits for a single subprocess execution. Zero or negative values mean unlimited.
+ */
+struct LIBRARY_EXPORT ExecutionLimits {
+	qint64 memoryBytes = -1; // Address space, or memory.max when the execution runs in its own cgroup
+	int cpuSeconds = -1; // CPU time, user and system combined
+	int maxOpenFiles = -1;
+
+	bool isEmpty() const;
+};
+
+/**
+ * @brief Applies ExecutionLimits to a child process through setrlimit, and optionally through a cgroup v2 leaf.
+ *
+ * The cgroup is created under a delegated subtree before the child is started and removed when this object
+ * is destroyed, which must only happen after the child has exited. Limits are not enforced on Windows.
+ */
+class LIBRARY_EXPORT ProcessLimits
+{
+public:
+	/**
+	 * @param cgroupRoot Delegated cgroup v2 directory to create the execution's leaf in. Empty for rlimits only.
+	 * @param name Name of the leaf cgroup.
+	 */
+	ProcessLimits(const ExecutionLimits& limits, const QString& cgroupRoot, const QString& name);
+	~ProcessLimits();
+
+	ProcessLimits(const ProcessLimits&) = delete;
+	ProcessLimits& operator=(const ProcessLimits&) = delete;
+
+	/**
+	 * @brief Runs in the forked child before exec: sets the rlimits and joins the cgroup. Async-signal-safe.
+	 */
+	void applyInChild() const;
+
+	/**
+	 * @brief True if the kernel OOM-killed a process of the execution's cgroup.
+	 */
+	bool cgroupMemoryLimitHit() const;
+
+	/**
+	 * @brief CPU time in microseconds used by the processes of the execution's cgroup, -1 without a cgroup.
+	 */
+	qint64 cgroupCpuTime() const;
+
+	const ExecutionLimits& limits() const;
+	bool usesCgroup() const;
+
+private:
+	ExecutionLimits executionLimits;
+	QString cgroupPath;
+	int cgroupProcsFd; // cgroup.procs, opened up front so the child only has to write to it
+
+	bool createCgroup(const QString& cgroupRoot, const QString& name);
+	bool writeCgroupFile(const QString& file, const QByteArray& value) const;
+};
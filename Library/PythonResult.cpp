@@ -1,13 +1,14 @@
 
 #include "PythonResult.h"
+#include <QTemporaryFile>
 
 PythonResult::PythonResult()
-	: success(false), output(), errorOutput(), errorCode(0),  executionTime(0)
+	: success(false), output(), errorOutput(), errorCode(0),  executionTime(0), outputSize(0), queueDepth(0), queueWaitTime(0)
 {
 }
 
 PythonResult::PythonResult(QString const& executionId, bool success, const QString& output, const QString& errorOutput,  qint64 executionTime)
-	: executionId(executionId), success(success), output(output), errorOutput(errorOutput), errorCode(0),  executionTime(executionTime)
+	: executionId(executionId), success(success), output(output), errorOutput(errorOutput), errorCode(0),  executionTime(executionTime), outputSize(0), queueDepth(0), queueWaitTime(0)
 {
 }
 
@@ -44,6 +45,127 @@ void PythonResult::setExecutionTime(qint64 time)
 	executionTime = time;
 }
 
+QString PythonResult::getOutputFilePath() const
+{
+	return outputFile ? outputFile->fileName() : QString();
+}
+
+QString PythonResult::getErrorOutputFilePath() const
+{
+	return errorOutputFile ? errorOutputFile->fileName() : QString();
+}
+
+bool PythonResult::isOutputTruncated() const
+{
+	return outputFile != nullptr || errorOutputFile != nullptr;
+}
+
+qint64 PythonResult::getOutputSize() const
+{
+	// Only spilled output needs the size recorded; otherwise the preview is the whole output
+	return outputFile ? outputSize : output.toUtf8().size();
+}
+
+void PythonResult::setOutputFile(const std::shared_ptr<QTemporaryFile>& file, qint64 totalSize)
+{
+	outputFile = file;
+	outputSize = totalSize;
+}
+
+void PythonResult::setErrorOutputFile(const std::shared_ptr<QTemporaryFile>& file)
+{
+	errorOutputFile = file;
+}
+
+int PythonResult::getQueueDepth() const
+{
+	return queueDepth;
+}
+
+qint64 PythonResult::getQueueWaitTime() const
+{
+	return queueWaitTime;
+}
+
+void PythonResult::setQueueStats(int depth, qint64 waitTime)
+{
+	queueDepth = depth;
+	queueWaitTime = waitTime;
+}
+
+ResourceUsage PythonResult::getResourceUsage() const
+{
+	return resourceUsage;
+}
+
+void PythonResult::setResourceUsage(const ResourceUsage& usage)
+{
+	resourceUsage = usage;
+}
+
+QString PythonResult::getProfile() const
+{
+	return profile;
+}
+
+void PythonResult::setProfile(const QString& collapsedStacks)
+{
+	profile = collapsedStacks;
+}
+
+bool PythonResult::hasResultBuffer() const
+{
+	return resultBuffer.has_value();
+}
+
+NumericBuffer PythonResult::getResultBuffer() const
+{
+	return resultBuffer.value_or(NumericBuffer());
+}
+
+void PythonResult::setResultBuffer(const NumericBuffer& buffer)
+{
+	resultBuffer = buffer;
+}
+
+QJsonObject ResourceUsage::toJson() const
+{
+	QJsonObject json;
+	json["userCpuTime"] = userCpuTime;
+	json["systemCpuTime"] = systemCpuTime;
+	json["peakRss"] = peakRss;
+	json["voluntaryContextSwitches"] = voluntaryContextSwitches;
+	json["involuntaryContextSwitches"] = involuntaryContextSwitches;
+	json["blockInputOperations"] = blockInputOperations;
+	json["blockOutputOperations"] = blockOutputOperations;
+	if (peakAllocatedBytes >= 0) {
+		json["peakAllocatedBytes"] = peakAllocatedBytes;
+	}
+	if (executedUnits >= 0) {
+		json["executedUnits"] = executedUnits;
+	}
+	return json;
+}
+
+ResourceUsage ResourceUsage::fromJson(const QJsonObject& json)
+{
+	ResourceUsage usage;
+	if (json.isEmpty())
+		return usage;
+
+	usage.available = true;
+	usage.userCpuTime = json["userCpuTime"].toInteger();
+	usage.systemCpuTime = json["systemCpuTime"].toInteger();
+	usage.peakRss = json["peakRss"].toInteger();
+	usage.voluntaryContextSwitches = json["voluntaryContextSwitches"].toInteger();
+	usage.involuntaryContextSwitches = json["involuntaryContextSwitches"].toInteger();
+	usage.blockInputOperations = json["blockInputOperations"].toInteger();
+	usage.blockOutputOperations = json["blockOutputOperations"].toInteger();
+	usage.peakAllocatedBytes = json["peakAllocatedBytes"].toInteger(-1);
+	usage.executedUnits = json["executedUnits"].toInteger(-1);
+	return usage;
+}
+
 QJsonObject PythonResult::toJson() const
 {
 	QJsonObject json;
@@ -53,6 +175,20 @@ QJsonObject PythonResult::toJson() const
 	json["errorCode"] = errorCode;
 	json["executionTime"] = executionTime;
 	json["executionId"] = executionId;
+	json["queueDepth"] = queueDepth;
+	json["queueWaitTime"] = queueWaitTime;
+	if (resourceUsage.available) {
+		json["resourceUsage"] = resourceUsage.toJson();
+	}
+	if (!profile.isEmpty()) {
+		json["profile"] = profile;
+	}
+	if (isOutputTruncated()) {
+		json["outputTruncated"] = true;
+		json["outputSize"] = outputSize;
+		json["outputFile"] = getOutputFilePath();
+		json["errorOutputFile"] = getErrorOutputFilePath();
+	}
 
 	return json;
 }
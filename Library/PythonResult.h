@@ -1,8 +1,14 @@
 #pragma once
 #include "global.h"
+#include "NumericBuffer.h"
 #include <QVariant>
 #include <QMetaType>
 #include <QJsonObject>
+#include <memory>
+#include <optional>
+
+class QTemporaryFile;
+
 enum class OperationType {
 	Install,
 	Reinstall,
@@ -13,6 +19,40 @@ enum class OperationType {
 	UpgradeAll,
 	Search
 };
+
+/**
+ * @brief Values of PythonResult::getErrorCode() for executions that did not run to completion.
+ */
+enum class ExecutionError : int {
+	None = 0,
+	Timeout = 1,
+	Cancelled = 2,
+	Rejected = 3, // Admission control turned the execution away because the wait queue was full
+	MemoryLimit = 4,
+	CpuLimit = 5,
+	OpenFilesLimit = 6,
+	BudgetExceeded = 7 // Embedded executions: ran more lines or opcodes than the execution budget allows
+};
+
+/**
+ * @brief Operating system resources consumed by one execution, including subprocesses the script waited for.
+ */
+struct LIBRARY_EXPORT ResourceUsage {
+	bool available = false; // False if the platform or backend could not measure the execution
+	qint64 userCpuTime = 0; // Microseconds
+	qint64 systemCpuTime = 0; // Microseconds
+	qint64 peakRss = 0; // Bytes
+	qint64 voluntaryContextSwitches = 0;
+	qint64 involuntaryContextSwitches = 0;
+	qint64 blockInputOperations = 0;
+	qint64 blockOutputOperations = 0;
+	qint64 peakAllocatedBytes = -1; // Embedded executions with memory quotas: peak of the script's Python allocations
+	qint64 executedUnits = -1; // Embedded executions with a budget: lines or opcodes the script ran
+
+	QJsonObject toJson() const;
+	static ResourceUsage fromJson(const QJsonObject& json);
+};
+
 /**
  * @brief Encapsulates the result of Python script execution.
  */
@@ -32,6 +72,45 @@ public:
     qint64 getExecutionTime() const;
     void setExecutionTime(qint64 time);
     void setErrorCode(int code);
+
+    /**
+     * @brief Path of the file holding the complete output if it exceeded the in-memory cap, empty otherwise.
+     * getOutput() then only returns a preview. The file is removed once the last copy of this result is gone.
+     */
+    QString getOutputFilePath() const;
+    QString getErrorOutputFilePath() const;
+    bool isOutputTruncated() const;
+    qint64 getOutputSize() const;
+    void setOutputFile(const std::shared_ptr<QTemporaryFile>& file, qint64 totalSize);
+    void setErrorOutputFile(const std::shared_ptr<QTemporaryFile>& file);
+
+    /**
+     * @brief Number of executions waiting ahead of this one when it was queued, 0 if it started right away.
+     */
+    int getQueueDepth() const;
+    /**
+     * @brief Time in milliseconds the execution spent in the admission queue. Not part of getExecutionTime().
+     */
+    qint64 getQueueWaitTime() const;
+    void setQueueStats(int depth, qint64 waitTime);
+
+    ResourceUsage getResourceUsage() const;
+    void setResourceUsage(const ResourceUsage& usage);
+
+    /**
+     * @brief Sampled Python stacks of the execution in collapsed format, one "outer;inner count" line per stack,
+     * ready for flamegraph tools. Empty unless the execution was profiled.
+     */
+    QString getProfile() const;
+    void setProfile(const QString& collapsedStacks);
+
+    /**
+     * @brief Array an embedded script handed back with embedpython.set_result(), in its own element type
+     * instead of printed text. Only set for successful executions; not part of toJson().
+     */
+    bool hasResultBuffer() const;
+    NumericBuffer getResultBuffer() const;
+    void setResultBuffer(const NumericBuffer& buffer);
     /**
      * @brief Converts the PythonResult into a QJsonObject for easy JSON manipulation.
      * @return A QJsonObject representing the result.
@@ -45,6 +124,14 @@ private:
     int errorCode;
     qint64 executionTime; // Execution time in milliseconds
     QString executionId;
+    qint64 outputSize; // Bytes the script wrote to stdout when it was spilled to outputFile
+    std::shared_ptr<QTemporaryFile> outputFile;
+    std::shared_ptr<QTemporaryFile> errorOutputFile;
+    int queueDepth;
+    qint64 queueWaitTime;
+    ResourceUsage resourceUsage;
+    QString profile;
+    std::optional<NumericBuffer> resultBuffer;
 };
 
 // Enable PythonResult to be used in Qt's signal-slot mechanism
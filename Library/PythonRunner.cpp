@@ -2,25 +2,80 @@
 #include <QCoreApplication>
 #include <QDebug>
 #include <QDir>
+#include <QFile>
 #include <QProcessEnvironment>
 #include <QPointer>
+#include <QThread>
+#include <QUuid>
+#include <QJsonDocument>
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#endif
+#include "WorkerPool.h"
+#include "TimerWheel.h"
+#include "ScriptPayload.h"
 
 PythonRunner::PythonRunner(QObject* parent)
-	: QObject(parent), pythonHome(getDefaultEnvPath()), pythonExecutablePath(getPythonExecutablePath())
+	: QObject(parent), pythonHome(getDefaultEnvPath()), pythonExecutablePath(getPythonExecutablePath()), workerPool(nullptr),
+	deadlines(new TimerWheel(10, 512, this)), streamingEnabled(false), retainStreamedOutput(true), outputMemoryLimit(-1),
+	maxInFlight(qMax(1, QThread::idealThreadCount())), maxQueued(-1), inFlight(0), terminationGracePeriod(2000),
+	reaper(new TimerWheel(10, 512, this)), queuedCount(0)
 {
+	connect(deadlines, &TimerWheel::expired, this, &PythonRunner::onDeadlineExpired);
+	connect(reaper, &TimerWheel::expired, this, &PythonRunner::onTerminationDeadline);
+
+	QFile bootstrapFile(":/scripts/bootstrap.py");
+	if (bootstrapFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
+		bootstrapSource = QString::fromUtf8(bootstrapFile.readAll());
+	}
+	else {
+		qCritical() << "Failed to load bootstrap script from resources.";
+	}
 }
 
 PythonRunner::~PythonRunner() {
+	// Queued executions never started, so there is nothing to kill
+	for (auto& queue : waitQueue) {
+		for (auto& entry : queue) {
+			entry.promise->finish();
+		}
+	}
+
+	// Nobody is left to wait for the grace periods
+	for (Termination* termination : terminations) {
+		signalProcessGroup(termination, true);
+		termination->process->disconnect(this);
+		termination->process->deleteLater();
+		termination->promise.addResult(false);
+		termination->promise.finish();
+		delete termination;
+	}
+
 	// Clean up any remaining executions
 	for (auto data : executions) {
 		if (data->process->state() != QProcess::NotRunning) {
+#ifdef Q_OS_UNIX
+			if (data->process->processId() > 0) {
+				::kill(-static_cast<pid_t>(data->process->processId()), SIGKILL);
+			}
+#endif
 			data->process->kill();
 		}
 		data->process->deleteLater();
-		data->timer->deleteLater();
 		data->promise.finish();
+#ifdef Q_OS_UNIX
+		if (data->usageFd != -1) {
+			::close(data->usageFd);
+		}
+#endif
 		delete data;
 	}
+
+	// Tear the pool down while the runner is still intact so pending pooled futures finish
+	delete workerPool;
 }
 
 // Getter functions
@@ -44,105 +99,391 @@ QString PythonRunner::getDefaultEnvPath() const {
 	pythonDir.cd("python");
 	return pythonDir.absolutePath();
 }
-QFuture<PythonResult> PythonRunner::runScriptAsync(const QString& executionId, const QString& script, const QVariantList& arguments, int timeout) {
+
+QProcessEnvironment PythonRunner::processEnvironment() const {
+	QProcessEnvironment environment;
+	environment.insert("PYTHONPATH", getSitePackagesPath());
+	environment.insert("PYTHONHOME", getDefaultEnvPath());
+	return environment;
+}
+
+void PythonRunner::setPoolSize(int minWorkers, int maxWorkers, const QStringList& preloadModules) {
+	if (maxWorkers <= 0) {
+		delete workerPool;
+		workerPool = nullptr;
+		return;
+	}
+
+	if (!workerPool) {
+		workerPool = new WorkerPool(pythonExecutablePath, processEnvironment(), this);
+		connect(workerPool, &WorkerPool::outputReceived, this, [this](const QString& executionId, bool errorOutput, const QString& chunk) {
+			if (errorOutput) {
+				emit errorOutputReceived(executionId, chunk);
+			}
+			else {
+				emit outputReceived(executionId, chunk);
+			}
+			});
+		if (!preloadModules.isEmpty()) {
+			workerPool->setZygoteModules(preloadModules);
+		}
+	}
+	workerPool->setPoolSize(minWorkers, maxWorkers);
+}
+
+void PythonRunner::setOutputMemoryLimit(qint64 bytes) {
+	outputMemoryLimit = bytes;
+}
+
+void PythonRunner::setMaxConcurrency(int maxInFlight, int maxQueued) {
+	this->maxInFlight = qMax(1, maxInFlight);
+	this->maxQueued = maxQueued;
+
+	// A raised limit lets waiting executions start right away
+	dispatchQueued();
+}
+
+void PythonRunner::setTerminationGracePeriod(int milliseconds) {
+	terminationGracePeriod = qMax(0, milliseconds);
+}
+
+void PythonRunner::setCgroupRoot(const QString& path) {
+	cgroupRoot = path;
+}
+
+void PythonRunner::attachSpilledOutput(PythonResult& result, const ExecutionData* data) const {
+	if (data->output.isSpilled()) {
+		result.setOutputFile(data->output.file(), data->output.size());
+	}
+	if (data->errorOutput.isSpilled()) {
+		result.setErrorOutputFile(data->errorOutput.file());
+	}
+}
+
+void PythonRunner::setStreamingEnabled(bool enabled, bool retainOutput) {
+	streamingEnabled = enabled;
+	retainStreamedOutput = retainOutput;
+}
+
+QFuture<PythonResult> PythonRunner::runScriptAsync(const QString& executionId, const QString& script, const QVariantList& arguments, int timeout,
+	int priority, const ExecutionLimits& limits) {
 	QPromise<PythonResult> promise;
 	QFuture<PythonResult> future = promise.future();
 
-	QProcess* process = new QProcess();
-	QProcessEnvironment environment;
+	if (inFlight < maxInFlight && queuedCount == 0) {
+		startExecution(executionId, script, arguments, timeout, limits, std::move(promise), 0, 0);
+		return future;
+	}
 
+	if (maxQueued >= 0 && queuedCount >= maxQueued) {
+		// Turning work away keeps the latency of everything already admitted bounded
+		qWarning() << "Admission queue is full, rejecting executionId:" << executionId;
+		PythonResult rejectedResult(executionId, false, "", "Execution rejected: too many pending executions.", 0);
+		rejectedResult.setErrorCode(static_cast<int>(ExecutionError::Rejected));
+		rejectedResult.setQueueStats(queuedCount, 0);
+		promise.addResult(rejectedResult);
+		promise.finish();
+
+		emit scriptFinished(executionId, rejectedResult);
+		return future;
+	}
 
-	environment.insert("PYTHONPATH", getSitePackagesPath());
-	environment.insert("PYTHONHOME", getDefaultEnvPath());
-	//env.insert("PYTHONUNBUFFERED", "1");
+	QueuedExecution entry{ executionId, script, arguments, timeout, limits,
+		std::make_shared<QPromise<PythonResult>>(std::move(promise)), QElapsedTimer(), queuedCount };
+	entry.waitTimer.start();
+	waitQueue[priority].enqueue(entry);
+	++queuedCount;
 
+	return future;
+}
+
+void PythonRunner::dispatchQueued() {
+	while (inFlight < maxInFlight && queuedCount > 0) {
+		auto highest = std::prev(waitQueue.end());
+		QueuedExecution entry = highest->dequeue();
+		if (highest->isEmpty()) {
+			waitQueue.erase(highest);
+		}
+		--queuedCount;
+
+		startExecution(entry.executionId, entry.script, entry.arguments, entry.timeout, entry.limits,
+			std::move(*entry.promise), entry.queueDepth, entry.waitTimer.elapsed());
+	}
+}
+
+bool PythonRunner::cancelQueued(const QString& executionId) {
+	for (auto it = waitQueue.begin(); it != waitQueue.end(); ++it) {
+		for (qsizetype i = 0; i < it->size(); ++i) {
+			if (it->at(i).executionId != executionId)
+				continue;
+
+			QueuedExecution entry = it->takeAt(i);
+			if (it->isEmpty()) {
+				waitQueue.erase(it);
+			}
+			--queuedCount;
+
+			PythonResult canceledResult(executionId, false, "", "Execution canceled by user.", 0);
+			canceledResult.setErrorCode(static_cast<int>(ExecutionError::Cancelled));
+			canceledResult.setQueueStats(entry.queueDepth, entry.waitTimer.elapsed());
+			entry.promise->addResult(canceledResult);
+			entry.promise->finish();
+			return true;
+		}
+	}
+	return false;
+}
+
+void PythonRunner::startExecution(const QString& executionId, const QString& script, const QVariantList& arguments, int timeout,
+	const ExecutionLimits& limits, QPromise<PythonResult>&& promise, int queueDepth, qint64 queueWaitTime) {
+	++inFlight;
+
+	// Prefer a warm interpreter; fall back to a one-shot process once the pool is exhausted.
+	// Workers are shared between executions, so limits can only be applied to a process of its own.
+	if (workerPool && limits.isEmpty() && workerPool->hasCapacity()) {
+		startPooledExecution(executionId, script, arguments, timeout, std::move(promise), queueDepth, queueWaitTime);
+		return;
+	}
+
+	QProcess* process = new QProcess();
+	QProcessEnvironment environment = processEnvironment();
+	if (streamingEnabled) {
+		// Block-buffered stdout would only arrive when the buffer fills up or the process exits
+		environment.insert("PYTHONUNBUFFERED", "1");
+	}
 
 	process->setProgram(pythonExecutablePath); // Adjust as needed
+	// Only the small bootstrap goes on the command line; the script follows through stdin
 	QStringList procArguments;
-	procArguments << "-c" << script;
+	procArguments << "-c" << bootstrapSource;
 	process->setArguments(procArguments);
 	process->setWorkingDirectory(getDefaultEnvPath());
 
-	process->setProcessEnvironment(environment);
+	std::shared_ptr<ProcessLimits> processLimits;
+	if (!limits.isEmpty()) {
+		processLimits = std::make_shared<ProcessLimits>(limits, cgroupRoot, QString("EmbedPython-%1").arg(QUuid::createUuid().toString(QUuid::Id128)));
+	}
 
-	QElapsedTimer* elapsedTimer = new QElapsedTimer();
-	elapsedTimer->start();
+	// The bootstrap reports the child's rusage through a pipe at exit. QProcess reaps the child itself,
+	// so the exit status is all wait4() would be left with on our side.
+	int usagePipe[2] = { -1, -1 };
+#ifdef Q_OS_UNIX
+	if (::pipe(usagePipe) == 0) {
+		::fcntl(usagePipe[0], F_SETFD, FD_CLOEXEC);
+		::fcntl(usagePipe[0], F_SETFL, O_NONBLOCK);
+		::fcntl(usagePipe[1], F_SETFD, FD_CLOEXEC);
 
-	QTimer* timeoutTimer = nullptr;
-	if (timeout != -1) {
-		timeoutTimer = new QTimer(this);
-		timeoutTimer->setSingleShot(true);
-		timeoutTimer->setInterval(timeout);
+		environment.insert("EMBEDPYTHON_RUSAGE_FD", QString::number(usagePipe[1]));
+	}
+	else {
+		usagePipe[0] = usagePipe[1] = -1;
 	}
 
-	ExecutionData* data = new ExecutionData{ executionId, process, timeoutTimer, std::move(promise), elapsedTimer };
+	const int writeFd = usagePipe[1];
+	process->setChildProcessModifier([writeFd, processLimits]() {
+		// A group of its own lets cancellation reach the processes the script starts
+		::setpgid(0, 0);
+		if (writeFd != -1) {
+			::fcntl(writeFd, F_SETFD, 0); // Survive exec
+		}
+		if (processLimits) {
+			processLimits->applyInChild();
+		}
+		});
+#endif
+
+	process->setProcessEnvironment(environment);
+
+	ExecutionData* data = new ExecutionData{ executionId, process, std::move(promise) };
+	data->usageFd = usagePipe[0];
+	data->limits = processLimits;
+	data->elapsedTimer.start();
+	data->output = OutputSpool(outputMemoryLimit);
+	data->errorOutput = OutputSpool(outputMemoryLimit);
+	data->queueDepth = queueDepth;
+	data->queueWaitTime = queueWaitTime;
 	executions.insert(executionId, data);
+	executionsByProcess.insert(process, data);
 
 
 	connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
 		this, &PythonRunner::onProcessFinished);
 	connect(process, &QProcess::errorOccurred,
 		this, &PythonRunner::onProcessErrorOccurred);
+	connect(process, &QProcess::readyReadStandardOutput,
+		this, &PythonRunner::onReadyRead);
+	connect(process, &QProcess::readyReadStandardError,
+		this, &PythonRunner::onReadyRead);
 
-	if (timeoutTimer) {
-		connect(timeoutTimer, &QTimer::timeout,
-			this, &PythonRunner::onTimeout);
+	if (timeout > 0) {
+		deadlines->schedule(executionId, timeout);
 	}
 
 	process->start();
 
-	if (timeoutTimer && timeout != -1) {
-		timeoutTimer->start();
+#ifdef Q_OS_UNIX
+	if (usagePipe[1] != -1) {
+		::close(usagePipe[1]); // Only the child writes; EOF once it is gone
 	}
+#endif
 
-	return future;
+	// A process that failed to start has already been cleaned up
+	if (!executionsByProcess.contains(process))
+		return;
+
+	// QProcess buffers the payload until the process has started and feeds it from the event loop
+	process->write(ScriptPayload::encode(script, arguments));
+	process->closeWriteChannel();
 }
 
-void PythonRunner::onTimeout() {
-	QTimer* senderTimer = qobject_cast<QTimer*>(sender());
-	if (!senderTimer)
-		return;
+QJsonObject PythonRunner::readChildReport(ExecutionData* data) const {
+	QJsonObject report;
+#ifdef Q_OS_UNIX
+	if (data->usageFd == -1)
+		return report;
+
+	// The report is written at interpreter exit, so it is complete once finished() is delivered
+	QByteArray bytes;
+	char buffer[512];
+	ssize_t bytesRead;
+	while ((bytesRead = ::read(data->usageFd, buffer, sizeof(buffer))) > 0) {
+		bytes.append(buffer, bytesRead);
+	}
 
-	QString executionId;
-	ExecutionData* data = nullptr;
+	if (!bytes.isEmpty()) {
+		report = QJsonDocument::fromJson(bytes).object();
+	}
+#else
+	Q_UNUSED(data);
+#endif
+	return report;
+}
+
+ExecutionError PythonRunner::classifyLimitHit(const ExecutionData* data, int exitCode, QProcess::ExitStatus exitStatus, const QJsonObject& report) const {
+	if (!data->limits)
+		return ExecutionError::None;
+
+	const ExecutionLimits& limits = data->limits->limits();
+#ifdef Q_OS_UNIX
+	// After a crash QProcess reports the terminating signal as the exit code
+	const int signal = exitStatus == QProcess::CrashExit ? exitCode : 0;
 
-	for (auto it = executions.begin(); it != executions.end(); ++it) {
-		if (it.value()->timer == senderTimer) {
-			executionId = it.key();
-			data = it.value();
-			break;
+	if (limits.cpuSeconds > 0 && signal == SIGXCPU) {
+		return ExecutionError::CpuLimit;
+	}
+	if (limits.memoryBytes > 0 && (report["exception"].toString() == "MemoryError" || data->limits->cgroupMemoryLimitHit())) {
+		return ExecutionError::MemoryLimit;
+	}
+	// The hard CPU limit kills with SIGKILL, but so does the OOM killer. Only count it if the child had
+	// actually used up its CPU time, as far as its report (if it got to write one) or its cgroup tells.
+	if (limits.cpuSeconds > 0 && signal == SIGKILL) {
+		const qint64 cpuTime = report.contains("userCpuTime")
+			? report["userCpuTime"].toInteger() + report["systemCpuTime"].toInteger()
+			: data->limits->cgroupCpuTime();
+		if (cpuTime >= static_cast<qint64>(limits.cpuSeconds) * 1000000) {
+			return ExecutionError::CpuLimit;
 		}
 	}
+	if (limits.maxOpenFiles > 0 && report["errno"].toInt() == EMFILE) {
+		return ExecutionError::OpenFilesLimit;
+	}
+#else
+	Q_UNUSED(limits);
+	Q_UNUSED(exitCode);
+	Q_UNUSED(exitStatus);
+	Q_UNUSED(report);
+#endif
+	return ExecutionError::None;
+}
+
+void PythonRunner::startPooledExecution(const QString& executionId, const QString& script, const QVariantList& arguments, int timeout,
+	QPromise<PythonResult>&& promise, int queueDepth, qint64 queueWaitTime) {
+	if (timeout > 0) {
+		deadlines->schedule(executionId, timeout);
+	}
 
+	auto sharedPromise = std::make_shared<QPromise<PythonResult>>(std::move(promise));
+	workerPool->executeScript(executionId, script, arguments, streamingEnabled, !streamingEnabled || retainStreamedOutput)
+		.then(this, [this, executionId, sharedPromise, queueDepth, queueWaitTime](const QJsonObject& reply) {
+			deadlines->cancel(executionId);
+
+			// Streamed chunks were emitted as they arrived; the reply carries retained output only, bounded by the cap
+			OutputSpool output(outputMemoryLimit);
+			OutputSpool errorOutput(outputMemoryLimit);
+			output.append(reply["output"].toString().toUtf8());
+			errorOutput.append(reply["error"].toString().toUtf8());
+
+			PythonResult result(executionId, reply["success"].toBool(), output.text(),
+				errorOutput.text(), reply["executionTime"].toInteger());
+			result.setErrorCode(reply["errorCode"].toInt());
+			result.setQueueStats(queueDepth, queueWaitTime);
+			result.setResourceUsage(ResourceUsage::fromJson(reply["resourceUsage"].toObject()));
+			if (output.isSpilled()) {
+				result.setOutputFile(output.file(), output.size());
+			}
+			if (errorOutput.isSpilled()) {
+				result.setErrorOutputFile(errorOutput.file());
+			}
+			sharedPromise->addResult(result);
+			sharedPromise->finish();
+
+			emit scriptFinished(executionId, result);
+
+			--inFlight;
+			dispatchQueued();
+			});
+}
+
+void PythonRunner::completeExecution(ExecutionData* data, PythonResult& result) {
+	attachSpilledOutput(result, data);
+	result.setQueueStats(data->queueDepth, data->queueWaitTime);
+	data->promise.addResult(result);
+	data->promise.finish();
+}
+
+void PythonRunner::onDeadlineExpired(const QString& executionId) {
+	ExecutionData* data = executions.value(executionId);
 	if (!data) {
-		senderTimer->deleteLater();
+		// Not a process of ours, so the deadline belongs to a pooled execution
+		if (workerPool && workerPool->cancel(executionId, "Execution timed out.", static_cast<int>(ExecutionError::Timeout))) {
+			qWarning() << "Timeout occurred for executionId:" << executionId;
+		}
 		return;
 	}
 
 	qWarning() << "Timeout occurred for executionId:" << executionId;
 
-	if (data->process->state() != QProcess::NotRunning) {
-		data->process->kill();
-		data->process->waitForFinished(1000);
-	}
+	beginTermination(data);
 
-	PythonResult timeoutResult(data->executionId, false, "", "Execution timed out.", data->elapsedTimer->elapsed());
-	data->promise.addResult(timeoutResult);
-	data->promise.finish();
+	PythonResult timeoutResult(data->executionId, false, "", "Execution timed out.", data->elapsedTimer.elapsed());
+	timeoutResult.setErrorCode(static_cast<int>(ExecutionError::Timeout));
+	completeExecution(data, timeoutResult);
 
 	cleanUpExecutionData(executionId, data);
 }
 
 void PythonRunner::cleanUpExecutionData(const QString& executionId, ExecutionData* data) {
-	if (data->timer) {
-		data->timer->stop();
-		data->timer->deleteLater();
+	deadlines->cancel(executionId);
+
+#ifdef Q_OS_UNIX
+	if (data->usageFd != -1) {
+		::close(data->usageFd);
 	}
+#endif
 
-	data->process->deleteLater();
-	delete data->elapsedTimer;
-	delete data;
+	// A terminating process already dropped the execution's handlers and is now watched by its Termination
+	if (!data->terminating) {
+		// Disconnect first, so signals still queued for the process cannot find a dangling entry
+		data->process->disconnect(this);
+		data->process->deleteLater();
+	}
+	executionsByProcess.remove(data->process);
 	executions.remove(executionId);
+	delete data;
+
+	// The freed slot goes to the next waiting execution
+	--inFlight;
+	dispatchQueued();
 }
 
 void PythonRunner::onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus) {
@@ -150,35 +491,39 @@ void PythonRunner::onProcessFinished(int exitCode, QProcess::ExitStatus exitStat
 	if (!senderProc)
 		return;
 
-	QString executionId;
-	ExecutionData* data = nullptr;
-
-	for (auto it = executions.begin(); it != executions.end(); ++it) {
-		if (it.value()->process == senderProc) {
-			executionId = it.key();
-			data = it.value();
-			break;
-		}
-	}
-
+	ExecutionData* data = findExecution(senderProc);
 	if (!data) {
 		senderProc->deleteLater();
 		return;
 	}
 
-	if (data->timer) {
-		data->timer->stop();
-		data->timer->deleteLater();
-	}
-
-	QString output = senderProc->readAllStandardOutput();
-	QString errorOutput = senderProc->readAllStandardError();
+	drainOutput(data);
+	QString output = data->output.text();
+	QString errorOutput = data->errorOutput.text();
 	bool success = (exitStatus == QProcess::NormalExit) && (exitCode == 0);
 
-	PythonResult result(executionId, success, output, errorOutput, data->elapsedTimer->elapsed());
-	data->promise.addResult(result);
-	data->promise.finish();
+	const QJsonObject report = readChildReport(data);
+	const ExecutionError limitHit = classifyLimitHit(data, exitCode, exitStatus, report);
+	switch (limitHit) {
+	case ExecutionError::MemoryLimit:
+		errorOutput += "\nExecution exceeded its memory limit.";
+		break;
+	case ExecutionError::CpuLimit:
+		errorOutput += "\nExecution exceeded its CPU time limit.";
+		break;
+	case ExecutionError::OpenFilesLimit:
+		errorOutput += "\nExecution exceeded its open files limit.";
+		break;
+	default:
+		break;
+	}
+
+	PythonResult result(data->executionId, success && limitHit == ExecutionError::None, output, errorOutput, data->elapsedTimer.elapsed());
+	result.setErrorCode(static_cast<int>(limitHit));
+	result.setResourceUsage(ResourceUsage::fromJson(report));
+	completeExecution(data, result);
 
+	const QString executionId = data->executionId;
 	emit scriptFinished(executionId, result);
 
 	cleanUpExecutionData(executionId, data);
@@ -189,54 +534,195 @@ void PythonRunner::onProcessErrorOccurred(QProcess::ProcessError error) {
 	if (!senderProc)
 		return;
 
-	QString executionId;
-	ExecutionData* data = nullptr;
-	for (auto it = executions.begin(); it != executions.end(); ++it) {
-		if (it.value()->process == senderProc) {
-			executionId = it.key();
-			data = it.value();
-			break;
-		}
-	}
+	// finished() follows a crash and reports it together with the limit that caused it
+	if (error == QProcess::Crashed)
+		return;
 
+	ExecutionData* data = findExecution(senderProc);
 	if (!data) {
 		senderProc->deleteLater();
 		return;
 	}
 
-	data->timer->stop();
-	data->timer->deleteLater();
-
-	QString output = senderProc->readAllStandardOutput();
-	QString errorOutput = senderProc->readAllStandardError();
+	drainOutput(data);
+	QString output = data->output.text();
+	QString errorOutput = data->errorOutput.text();
 	PythonResult result(data->executionId, false, output, errorOutput + " Process error occurred.", 0);
+	completeExecution(data, result);
 
-	data->promise.addResult(result);
-	data->promise.finish();
-
+	const QString executionId = data->executionId;
 	emit scriptFinished(executionId, result);
 	cleanUpExecutionData(executionId, data);
 }
 
+PythonRunner::ExecutionData* PythonRunner::findExecution(QProcess* process) const {
+	return executionsByProcess.value(process, nullptr);
+}
+
+void PythonRunner::onReadyRead() {
+	QProcess* senderProc = qobject_cast<QProcess*>(sender());
+	if (!senderProc)
+		return;
+
+	ExecutionData* data = findExecution(senderProc);
+	if (data) {
+		drainOutput(data);
+	}
+}
+
+void PythonRunner::drainOutput(ExecutionData* data) {
+	const QByteArray outputChunk = data->process->readAllStandardOutput();
+	const QByteArray errorChunk = data->process->readAllStandardError();
+	const bool retain = !streamingEnabled || retainStreamedOutput;
+
+	if (!outputChunk.isEmpty()) {
+		if (retain) {
+			data->output.append(outputChunk);
+		}
+		if (streamingEnabled) {
+			emit outputReceived(data->executionId, data->outputDecoder(outputChunk));
+		}
+	}
+
+	if (!errorChunk.isEmpty()) {
+		if (retain) {
+			data->errorOutput.append(errorChunk);
+		}
+		if (streamingEnabled) {
+			emit errorOutputReceived(data->executionId, data->errorDecoder(errorChunk));
+		}
+	}
+}
+
 bool PythonRunner::cancel(const QString& executionId) {
+	if (!executions.contains(executionId) && cancelQueued(executionId)) {
+		return true;
+	}
+
+	if (!executions.contains(executionId) && workerPool
+		&& workerPool->cancel(executionId, "Execution canceled by user.", static_cast<int>(ExecutionError::Cancelled))) {
+		return true;
+	}
+
 	if (!executions.contains(executionId)) {
 		qWarning() << "Cancel requested for unknown executionId:" << executionId;
 		return false;
 	}
 
-	ExecutionData* data = executions.value(executionId);
+	cancelAsync(executionId);
+	return true;
+}
+
+QFuture<bool> PythonRunner::cancelAsync(const QString& executionId) {
+	for (Termination* termination : terminations) {
+		if (termination->executionId == executionId) {
+			return termination->future;
+		}
+	}
 
-	if (data->process->state() != QProcess::NotRunning) {
-		data->process->kill(); // Terminate the process
-		data->process->waitForFinished(1000);
+	ExecutionData* data = executions.value(executionId);
+	if (!data) {
+		// Queued and pooled executions have no process group of their own to wait for
+		QPromise<bool> promise;
+		promise.addResult(cancel(executionId));
+		promise.finish();
+		return promise.future();
 	}
 
+	QFuture<bool> terminated = beginTermination(data);
+
 	// Set the promise result to indicate cancellation
 	PythonResult canceledResult(executionId, false, "", "Execution canceled by user.", 0);
-	data->promise.addResult(canceledResult);
-	data->promise.finish();
+	canceledResult.setErrorCode(static_cast<int>(ExecutionError::Cancelled));
+	completeExecution(data, canceledResult);
 
 	cleanUpExecutionData(executionId, data);
+	return terminated;
+}
 
-	return true;
-}
\ No newline at end of file
+QFuture<bool> PythonRunner::beginTermination(ExecutionData* data) {
+	QProcess* process = data->process;
+	data->terminating = true;
+	process->disconnect(this); // The execution reports its own result; the process only needs reaping now
+
+	Termination* termination = new Termination{ data->executionId, process, process->processId(), data->limits };
+	termination->future = termination->promise.future();
+	termination->promise.start();
+	const QFuture<bool> future = termination->future;
+
+	if (process->state() == QProcess::NotRunning || termination->processGroup <= 0) {
+		process->kill();
+		process->deleteLater();
+		termination->promise.addResult(true);
+		termination->promise.finish();
+		delete termination;
+		return future;
+	}
+
+	terminations.insert(termination->processGroup, termination);
+	connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this, [this, termination]() {
+		checkTermination(termination);
+		});
+
+	signalProcessGroup(termination, false);
+	termination->signalled.start();
+	reaper->schedule(QString::number(termination->processGroup), terminationGracePeriod);
+	return future;
+}
+
+void PythonRunner::signalProcessGroup(Termination* termination, bool kill) const {
+#ifdef Q_OS_UNIX
+	::kill(-static_cast<pid_t>(termination->processGroup), kill ? SIGKILL : SIGTERM);
+#else
+	// No process groups to signal; TerminateProcess is the only reliable way to stop a console process
+	Q_UNUSED(kill);
+	termination->process->kill();
+#endif
+}
+
+void PythonRunner::onTerminationDeadline(const QString& key) {
+	Termination* termination = terminations.value(key.toLongLong());
+	if (!termination)
+		return;
+
+	if (!termination->escalated && termination->signalled.elapsed() < terminationGracePeriod) {
+		// A liveness poll, not the grace deadline
+		checkTermination(termination);
+		return;
+	}
+
+	if (!termination->escalated) {
+		qWarning() << "Process group of executionId" << termination->executionId << "outlived the grace period, killing it.";
+		termination->escalated = true;
+		signalProcessGroup(termination, true);
+	}
+	checkTermination(termination);
+}
+
+void PythonRunner::checkTermination(Termination* termination) {
+	bool groupGone = termination->process->state() == QProcess::NotRunning;
+#ifdef Q_OS_UNIX
+	// Probing with signal 0 fails with ESRCH once the last member of the group has been reaped
+	groupGone = groupGone && ::kill(-static_cast<pid_t>(termination->processGroup), 0) == -1 && errno == ESRCH;
+#endif
+
+	const QString key = QString::number(termination->processGroup);
+	if (!groupGone) {
+		// Poll until the kill has taken effect, or until the rest of the group follows the interpreter out.
+		// While the interpreter runs, its finished signal brings us back before the grace deadline.
+		if (termination->escalated) {
+			reaper->schedule(key, 50);
+		} else if (termination->process->state() == QProcess::NotRunning) {
+			reaper->schedule(key, static_cast<int>(qMin<qint64>(50, terminationGracePeriod - termination->signalled.elapsed())));
+		}
+		return;
+	}
+
+	reaper->cancel(key);
+	terminations.remove(termination->processGroup);
+	termination->process->disconnect(this);
+	termination->process->deleteLater();
+	termination->promise.addResult(true);
+	termination->promise.finish();
+	delete termination; // Releases the execution's cgroup, which is empty now
+}
@@ -4,10 +4,21 @@
 #include <QObject>
 #include <QProcess>
 #include <QTimer>
+#include <QElapsedTimer>
+#include <QProcessEnvironment>
 #include <QFuture>
 #include <QPromise>
 #include <QHash>
+#include <QMap>
+#include <QQueue>
+#include <memory>
+#include <QStringDecoder>
 #include "PythonResult.h"
+#include "OutputSpool.h"
+#include "ProcessLimits.h"
+
+class WorkerPool;
+class TimerWheel;
 
 class LIBRARY_EXPORT PythonRunner : public QObject {
     Q_OBJECT
@@ -16,42 +27,178 @@ public:
     ~PythonRunner();
 
 
-    QFuture<PythonResult> runScriptAsync(const QString& executionId, const QString& script, const QVariantList& arguments = {}, int timeout = -1);
+    /**
+     * @brief Runs a script, or queues it while the concurrency limit is reached.
+     * @param arguments Exposed to the script as the globals arg1..argN. The script and its arguments are streamed
+     *        to the interpreter through stdin, so their size is not bounded by the command line.
+     * @param timeout Milliseconds the script may run, not counting time spent queued. -1 for no limit.
+     * @param priority Queued executions with a higher priority start first; equal priorities start in FIFO order.
+     * @param limits Memory, CPU time and open file limits for this execution. An execution with limits always runs
+     *        in its own process rather than on a pooled worker. A hit limit is reported through the result's error code.
+     */
+    QFuture<PythonResult> runScriptAsync(const QString& executionId, const QString& script, const QVariantList& arguments = {}, int timeout = -1,
+        int priority = 0, const ExecutionLimits& limits = {});
 
     /**
-     * @brief Cancels the execution of a script.
+     * @brief Cancels the execution of a script. Does not wait for the process to exit, see cancelAsync().
      * @param executionId The unique identifier of the script execution to cancel.
      * @return True if the execution was successfully canceled, false otherwise.
      */
     bool cancel(const QString& executionId);
 
+    /**
+     * @brief Cancels an execution without blocking and reports when its processes are gone.
+     *
+     * The execution's future resolves right away. Its process group receives SIGTERM, and SIGKILL once the
+     * termination grace period has passed, so subprocesses the script started are stopped as well.
+     * @return Resolves to true once no process of the group is left, or to false for an unknown executionId.
+     */
+    QFuture<bool> cancelAsync(const QString& executionId);
+
+    /**
+     * @brief Time a cancelled or timed-out process group gets to exit after SIGTERM before it is killed.
+     */
+    void setTerminationGracePeriod(int milliseconds);
+
+    /**
+     * @brief Enables pooled execution on warm interpreter processes.
+     * @param minWorkers Number of interpreters kept warm at all times.
+     * @param maxWorkers Upper bound on pooled interpreters. Requests beyond it spawn a one-shot process.
+     *        Pass 0 to disable pooling.
+     * @param preloadModules On Linux, workers are forked from a template interpreter that has imported
+     *        these modules once, so spawning a worker skips interpreter startup and the heavy imports.
+     */
+    void setPoolSize(int minWorkers, int maxWorkers, const QStringList& preloadModules = {});
+
+    /**
+     * @brief Enables incremental delivery of script output through outputReceived() and errorOutputReceived().
+     * @param enabled Emit output chunks as the process produces them. Pooled workers send their output line by line.
+     * @param retainOutput Keep the full output in the final PythonResult as well.
+     *        Disable it when the chunks are consumed directly, so the runner does not hold the whole output in memory.
+     */
+    void setStreamingEnabled(bool enabled, bool retainOutput = true);
+
+    /**
+     * @brief Caps the output kept in memory per execution and stream.
+     * @param bytes Output beyond the cap is spilled to a temporary file referenced by the PythonResult,
+     *        whose getOutput() then returns the first bytes as a preview. Use -1 for no cap.
+     */
+    void setOutputMemoryLimit(qint64 bytes);
+
+    /**
+     * @brief Configures admission control.
+     * @param maxInFlight Executions allowed to run at once, pooled or not. Defaults to the number of cores.
+     * @param maxQueued Executions allowed to wait for a free slot. Requests beyond it fail immediately
+     *        with ExecutionError::Rejected. Use -1 for an unbounded queue, the default.
+     */
+    void setMaxConcurrency(int maxInFlight, int maxQueued = -1);
+
+    /**
+     * @brief Places every execution with limits in its own cgroup v2 leaf below the given directory.
+     * @param path Subtree delegated to this process, with the memory controller enabled in its
+     *        cgroup.subtree_control. The memory limit then becomes memory.max instead of an address-space rlimit.
+     *        Pass an empty path to use rlimits only.
+     */
+    void setCgroupRoot(const QString& path);
+
 signals:
     void scriptFinished(const QString& executionId, const PythonResult& result);
+    void outputReceived(const QString& executionId, const QString& chunk);
+    void errorOutputReceived(const QString& executionId, const QString& chunk);
 
 private slots:
     void onProcessFinished(int exitCode, QProcess::ExitStatus exitStatus);
     void onProcessErrorOccurred(QProcess::ProcessError error);
-    void onTimeout();
+    void onDeadlineExpired(const QString& executionId);
+    void onTerminationDeadline(const QString& key);
+    void onReadyRead();
 
 private:
     QString pythonHome;
     QString pythonExecutablePath;
+    QString bootstrapSource; // scripts/bootstrap.py, reads the script payload from stdin
     QString getPythonExecutablePath() const;
 	QString getSitePackagesPath() const;
 	QString getDefaultEnvPath() const;
+    QProcessEnvironment processEnvironment() const;
+
+    WorkerPool* workerPool;
+    TimerWheel* deadlines; // One tick source for the timeouts of all executions, pooled or not
+    bool streamingEnabled;
+    bool retainStreamedOutput;
+    qint64 outputMemoryLimit;
+    int maxInFlight;
+    int maxQueued;
+    int inFlight;
+    QString cgroupRoot;
+    int terminationGracePeriod;
 
     struct ExecutionData {
         QString executionId;
 
         QProcess* process;
-        QTimer* timer;
         QPromise<PythonResult> promise;
-        QElapsedTimer* elapsedTimer;
+        QElapsedTimer elapsedTimer;
+        int queueDepth = 0;
+        qint64 queueWaitTime = 0;
+        int usageFd = -1; // Read end of the pipe the child reports its rusage on
+        std::shared_ptr<ProcessLimits> limits; // Outlives the child, so its cgroup can be removed afterwards
+        bool terminating = false; // The process now belongs to a Termination
+
+        OutputSpool output;
+        OutputSpool errorOutput;
+        QStringDecoder outputDecoder{ QStringDecoder::Utf8 }; // Keeps multi-byte sequences split across chunks intact
+        QStringDecoder errorDecoder{ QStringDecoder::Utf8 };
     };
 
     QHash<QString, ExecutionData*> executions;
+    QHash<QProcess*, ExecutionData*> executionsByProcess; // Reverse index for the process signal handlers
+
+    struct QueuedExecution {
+        QString executionId;
+        QString script;
+        QVariantList arguments;
+        int timeout;
+        ExecutionLimits limits;
+        std::shared_ptr<QPromise<PythonResult>> promise; // QQueue needs a copyable element
+        QElapsedTimer waitTimer;
+        int queueDepth;
+    };
+
+    // A cancelled or timed-out process that is still shutting down, along with the rest of its process group
+    struct Termination {
+        QString executionId;
+        QProcess* process;
+        qint64 processGroup;
+        std::shared_ptr<ProcessLimits> limits;
+        QPromise<bool> promise;
+        QFuture<bool> future;
+        QElapsedTimer signalled; // Started with SIGTERM, measures the grace period
+        bool escalated = false; // SIGKILL has been sent
+    };
+
+    QHash<qint64, Termination*> terminations; // Keyed by process group
+    TimerWheel* reaper; // Grace periods and liveness polls of terminations, keyed by process group
+
+    QMap<int, QQueue<QueuedExecution>> waitQueue; // Keyed by priority, the last key is served first
+    int queuedCount;
 
     void setupProcess(const QString& executionId, const QString& script, const QVariantList& arguments, int timeout);
 	void cleanUpExecutionData(const QString& executionId, ExecutionData* data);
+    ExecutionData* findExecution(QProcess* process) const;
+    void drainOutput(ExecutionData* data);
+    void attachSpilledOutput(PythonResult& result, const ExecutionData* data) const;
+    void startExecution(const QString& executionId, const QString& script, const QVariantList& arguments, int timeout,
+        const ExecutionLimits& limits, QPromise<PythonResult>&& promise, int queueDepth, qint64 queueWaitTime);
+    void startPooledExecution(const QString& executionId, const QString& script, const QVariantList& arguments, int timeout,
+        QPromise<PythonResult>&& promise, int queueDepth, qint64 queueWaitTime);
+    void completeExecution(ExecutionData* data, PythonResult& result);
+    QJsonObject readChildReport(ExecutionData* data) const;
+    ExecutionError classifyLimitHit(const ExecutionData* data, int exitCode, QProcess::ExitStatus exitStatus, const QJsonObject& report) const;
+    void dispatchQueued();
+    bool cancelQueued(const QString& executionId);
+    QFuture<bool> beginTermination(ExecutionData* data);
+    void checkTermination(Termination* termination);
+    void signalProcessGroup(Termination* termination, bool kill) const;
 
 };
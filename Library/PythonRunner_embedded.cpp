@@ -1,14 +1,407 @@
 #include <Python.h>
-#include "PythonRunner.h"
+#include "PythonRunner_embedded.h"
 #include <QElapsedTimer>
 #include <QDebug>
-#include <QtConcurrent>
+#include <QPromise>
+#include <QThread>
+#include <QMutex>
+#include <QDir>
+#include <QCoreApplication>
 #include <QFutureWatcher>
 #include <QTimer>
 #include <atomic>
+#include <mutex>
+#include <optional>
 #include <QList>
 #include "DataConverter.h"
 #include "PythonEnvironment.h"
+#include "OutputSpool.h"
+#include "InterpreterPool.h"
+#include "TimerWheel.h"
+#include "CodeCache.h"
+#include "MemoryQuota.h"
+#include "SamplingProfiler.h"
+#include <QRandomGenerator>
+#if defined(Q_OS_LINUX)
+#include <sys/resource.h>
+#elif defined(Q_OS_WIN)
+#include <windows.h>
+#endif
+
+// Scripts share the process with the host, so only the calling thread's counters describe one execution
+static ResourceUsage sampleThreadUsage() {
+	ResourceUsage usage;
+#if defined(Q_OS_LINUX)
+	struct rusage threadUsage;
+	struct rusage processUsage;
+	if (getrusage(RUSAGE_THREAD, &threadUsage) == 0 && getrusage(RUSAGE_SELF, &processUsage) == 0) {
+		usage.available = true;
+		usage.userCpuTime = threadUsage.ru_utime.tv_sec * 1000000LL + threadUsage.ru_utime.tv_usec;
+		usage.systemCpuTime = threadUsage.ru_stime.tv_sec * 1000000LL + threadUsage.ru_stime.tv_usec;
+		usage.peakRss = processUsage.ru_maxrss * 1024LL;
+		usage.voluntaryContextSwitches = threadUsage.ru_nvcsw;
+		usage.involuntaryContextSwitches = threadUsage.ru_nivcsw;
+		usage.blockInputOperations = threadUsage.ru_inblock;
+		usage.blockOutputOperations = threadUsage.ru_oublock;
+	}
+#elif defined(Q_OS_WIN)
+	FILETIME creationTime, exitTime, kernelTime, userTime;
+	if (GetThreadTimes(GetCurrentThread(), &creationTime, &exitTime, &kernelTime, &userTime)) {
+		auto toMicroseconds = [](const FILETIME& time) {
+			return static_cast<qint64>((static_cast<quint64>(time.dwHighDateTime) << 32 | time.dwLowDateTime) / 10);
+		};
+		usage.available = true;
+		usage.userCpuTime = toMicroseconds(userTime);
+		usage.systemCpuTime = toMicroseconds(kernelTime);
+	}
+#endif
+	return usage;
+}
+
+// Spools of the execution running on this thread, indexed by OutputStream. Each pool thread runs one execution
+// at a time, so the routers below find the right buffer without any lookup in Python.
+enum OutputStream { StandardOutput = 0, StandardError = 1 };
+static thread_local OutputSpool* capturedStreams[2] = { nullptr, nullptr };
+
+// File-like object installed once per interpreter as sys.stdout and sys.stderr. write() appends the UTF-8 form of
+// the text straight into the spool of the execution on the calling thread. Writes from threads without a running
+// execution, e.g. threads a script started, go to the stream the router replaced.
+struct OutputRouterObject {
+	PyObject_HEAD
+	int stream; // OutputStream
+	PyObject* fallback; // The original sys.stdout or sys.stderr, may be None
+};
+
+static PyObject* outputRouterWrite(PyObject* self, PyObject* text) {
+	OutputRouterObject* router = reinterpret_cast<OutputRouterObject*>(self);
+	OutputSpool* spool = capturedStreams[router->stream];
+	if (!spool) {
+		if (router->fallback == Py_None)
+			return PyLong_FromSsize_t(PyUnicode_Check(text) ? PyUnicode_GetLength(text) : 0);
+		return PyObject_CallMethod(router->fallback, "write", "O", text);
+	}
+
+	if (!PyUnicode_Check(text)) {
+		PyErr_Format(PyExc_TypeError, "write() argument must be str, not %.100s", Py_TYPE(text)->tp_name);
+		return nullptr;
+	}
+
+	// Compact ASCII strings hand out their own storage here, so nothing is copied before the spool
+	Py_ssize_t size = 0;
+	const char* utf8 = PyUnicode_AsUTF8AndSize(text, &size);
+	if (utf8) {
+		spool->append(utf8, size);
+	}
+	else {
+		// Lone surrogates have no UTF-8 form; StringIO would have kept them, so escape instead of failing
+		PyErr_Clear();
+		PyObject* escaped = PyUnicode_AsEncodedString(text, "utf-8", "backslashreplace");
+		if (!escaped)
+			return nullptr;
+		spool->append(PyBytes_AS_STRING(escaped), PyBytes_GET_SIZE(escaped));
+		Py_DECREF(escaped);
+	}
+	return PyLong_FromSsize_t(PyUnicode_GetLength(text));
+}
+
+static PyObject* outputRouterFlush(PyObject* self, PyObject*) {
+	OutputRouterObject* router = reinterpret_cast<OutputRouterObject*>(self);
+	if (capturedStreams[router->stream] || router->fallback == Py_None) {
+		Py_RETURN_NONE;
+	}
+	return PyObject_CallMethod(router->fallback, "flush", nullptr);
+}
+
+static PyObject* outputRouterIsatty(PyObject*, PyObject*) {
+	Py_RETURN_FALSE;
+}
+
+static PyObject* outputRouterWritable(PyObject*, PyObject*) {
+	Py_RETURN_TRUE;
+}
+
+static PyObject* outputRouterEncoding(PyObject*, void*) {
+	return PyUnicode_FromString("utf-8");
+}
+
+// Anything else a script expects of a stream, such as fileno() or buffer, comes from the original one
+static PyObject* outputRouterGetAttr(PyObject* self, PyObject* name) {
+	PyObject* attribute = PyObject_GenericGetAttr(self, name);
+	OutputRouterObject* router = reinterpret_cast<OutputRouterObject*>(self);
+	if (attribute || !PyErr_ExceptionMatches(PyExc_AttributeError) || router->fallback == Py_None)
+		return attribute;
+
+	PyErr_Clear();
+	return PyObject_GetAttr(router->fallback, name);
+}
+
+static void outputRouterDealloc(PyObject* self) {
+	PyTypeObject* type = Py_TYPE(self);
+	Py_XDECREF(reinterpret_cast<OutputRouterObject*>(self)->fallback);
+	PyObject_Free(self);
+	Py_DECREF(type); // Instances of heap types own a reference to their type
+}
+
+static PyMethodDef outputRouterMethods[] = {
+	{ "write", outputRouterWrite, METH_O, nullptr },
+	{ "flush", outputRouterFlush, METH_NOARGS, nullptr },
+	{ "isatty", outputRouterIsatty, METH_NOARGS, nullptr },
+	{ "writable", outputRouterWritable, METH_NOARGS, nullptr },
+	{ nullptr, nullptr, 0, nullptr }
+};
+
+static PyGetSetDef outputRouterGetSet[] = {
+	{ "encoding", outputRouterEncoding, nullptr, nullptr, nullptr },
+	{ nullptr, nullptr, nullptr, nullptr, nullptr }
+};
+
+static PyType_Slot outputRouterSlots[] = {
+	{ Py_tp_methods, outputRouterMethods },
+	{ Py_tp_getset, outputRouterGetSet },
+	{ Py_tp_getattro, reinterpret_cast<void*>(outputRouterGetAttr) },
+	{ Py_tp_dealloc, reinterpret_cast<void*>(outputRouterDealloc) },
+	{ 0, nullptr }
+};
+
+static PyType_Spec outputRouterSpec = {
+	"embedpython.OutputRouter",
+	sizeof(OutputRouterObject),
+	0,
+	Py_TPFLAGS_DEFAULT | Py_TPFLAGS_DISALLOW_INSTANTIATION,
+	outputRouterSlots
+};
+
+static bool installOutputRouter(PyTypeObject* routerType, const char* name, int stream) {
+	OutputRouterObject* router = PyObject_New(OutputRouterObject, routerType);
+	if (!router)
+		return false;
+
+	PyObject* current = PySys_GetObject(name); // Borrowed
+	router->stream = stream;
+	router->fallback = Py_NewRef(current ? current : Py_None);
+	const bool installed = PySys_SetObject(name, reinterpret_cast<PyObject*>(router)) == 0;
+	Py_DECREF(router);
+	return installed;
+}
+
+/**
+ * @brief Makes sure sys.stdout and sys.stderr of the current interpreter are OutputRouters. The caller holds the GIL.
+ * Cheap once installed; reinstalls the routers if a script replaced the streams.
+ */
+static bool ensureOutputRouters() {
+	// A heap type per interpreter, since sub-interpreters with their own GIL cannot share type objects
+	PyObject* interpreterDict = PyInterpreterState_GetDict(PyInterpreterState_Get()); // Borrowed
+	if (!interpreterDict)
+		return false;
+
+	PyObject* routerType = PyDict_GetItemString(interpreterDict, "EmbedPython.OutputRouter"); // Borrowed
+	if (!routerType) {
+		routerType = PyType_FromSpec(&outputRouterSpec);
+		if (!routerType)
+			return false;
+		PyDict_SetItemString(interpreterDict, "EmbedPython.OutputRouter", routerType);
+		Py_DECREF(routerType);
+	}
+
+	PyTypeObject* type = reinterpret_cast<PyTypeObject*>(routerType);
+	PyObject* stdoutObj = PySys_GetObject("stdout");
+	PyObject* stderrObj = PySys_GetObject("stderr");
+	bool installed = true;
+	if (!stdoutObj || !Py_IS_TYPE(stdoutObj, type)) {
+		installed = installOutputRouter(type, "stdout", StandardOutput) && installed;
+	}
+	if (!stderrObj || !Py_IS_TYPE(stderrObj, type)) {
+		installed = installOutputRouter(type, "stderr", StandardError) && installed;
+	}
+	return installed;
+}
+
+/**
+ * @brief Routes this thread's writes to sys.stdout and sys.stderr into two spools for the lifetime of the object.
+ */
+class OutputCapture {
+public:
+	OutputCapture(OutputSpool* output, OutputSpool* errorOutput)
+		: previousOutput(capturedStreams[StandardOutput]), previousErrorOutput(capturedStreams[StandardError]) {
+		capturedStreams[StandardOutput] = output;
+		capturedStreams[StandardError] = errorOutput;
+	}
+
+	~OutputCapture() {
+		capturedStreams[StandardOutput] = previousOutput;
+		capturedStreams[StandardError] = previousErrorOutput;
+	}
+
+	OutputCapture(const OutputCapture&) = delete;
+	OutputCapture& operator=(const OutputCapture&) = delete;
+
+private:
+	OutputSpool* previousOutput;
+	OutputSpool* previousErrorOutput;
+};
+
+// Where embedpython.set_result() stores the array of the execution running on this thread
+static thread_local std::optional<NumericBuffer>* capturedResult = nullptr;
+
+static PyObject* setResult(PyObject*, PyObject* obj) {
+	if (!capturedResult) {
+		PyErr_SetString(PyExc_RuntimeError, "set_result() can only be called from the thread running the script.");
+		return nullptr;
+	}
+	if (obj == Py_None) {
+		capturedResult->reset();
+		Py_RETURN_NONE;
+	}
+
+	std::optional<NumericBuffer> buffer = DataConverter::PyObjectToNumericBuffer(obj);
+	if (!buffer)
+		return nullptr;
+	*capturedResult = std::move(buffer);
+	Py_RETURN_NONE;
+}
+
+static PyMethodDef embedpythonMethods[] = {
+	{ "set_result", setResult, METH_O,
+		"set_result(obj)\n--\n\nHands an object supporting the buffer protocol back to C++ as the execution's result buffer." },
+	{ nullptr, nullptr, 0, nullptr }
+};
+
+/**
+ * @brief Registers the embedpython module scripts import to talk to the runner. The caller holds the GIL.
+ */
+static bool installEmbedpythonModule() {
+	PyObject* module = PyModule_New("embedpython");
+	if (!module)
+		return false;
+
+	const bool installed = PyModule_AddFunctions(module, embedpythonMethods) == 0
+		&& PyDict_SetItemString(PyImport_GetModuleDict(), "embedpython", module) == 0;
+	Py_DECREF(module);
+	return installed;
+}
+
+/**
+ * @brief Exception type the runner raises into scripts, created once per interpreter. The caller holds the GIL.
+ * Derives from BaseException so "except Exception" in the script does not swallow it.
+ * @param name Name within the embedpython namespace, e.g. "ExecutionCancelled".
+ * @return Borrowed reference, or nullptr with an exception set.
+ */
+static PyObject* interpreterExceptionType(const char* name) {
+	PyObject* interpreterDict = PyInterpreterState_GetDict(PyInterpreterState_Get()); // Borrowed
+	if (!interpreterDict)
+		return nullptr;
+
+	const QByteArray key = QByteArray("EmbedPython.") + name;
+	PyObject* exceptionType = PyDict_GetItemString(interpreterDict, key.constData()); // Borrowed
+	if (!exceptionType) {
+		exceptionType = PyErr_NewException((QByteArray("embedpython.") + name).constData(), PyExc_BaseException, nullptr);
+		if (!exceptionType)
+			return nullptr;
+		PyDict_SetItemString(interpreterDict, key.constData(), exceptionType);
+		Py_DECREF(exceptionType);
+	}
+	return exceptionType;
+}
+
+// The exception cancel() raises in a running script
+static PyObject* executionCancelledType() {
+	return interpreterExceptionType("ExecutionCancelled");
+}
+
+// Lines or opcodes an execution may run before BudgetExceeded is raised in it
+struct ExecutionBudget {
+	qint64 limit = -1;
+	qint64 used = 0;
+	bool opcodes = false;
+	bool exceeded = false;
+};
+
+// The budget of the execution on this thread; the trace function is per thread state as well
+static thread_local ExecutionBudget* currentBudget = nullptr;
+
+static int chargeBudget(PyObject*, PyFrameObject* frame, int what, PyObject*) {
+	ExecutionBudget* budget = currentBudget;
+	if (!budget)
+		return 0;
+
+	if (what == PyTrace_CALL && budget->opcodes) {
+		// Opcode events have to be requested per frame
+		if (PyObject_SetAttrString(reinterpret_cast<PyObject*>(frame), "f_trace_opcodes", Py_True) < 0) {
+			PyErr_Clear();
+		}
+		return 0;
+	}
+
+	if (what != (budget->opcodes ? PyTrace_OPCODE : PyTrace_LINE) || ++budget->used <= budget->limit)
+		return 0;
+
+	// Raised again on every further event, so catching it does not buy the script more work
+	budget->exceeded = true;
+	PyObject* exceededType = interpreterExceptionType("BudgetExceeded");
+	if (exceededType) {
+		PyErr_Format(exceededType, "Execution budget of %lld %s exceeded.", static_cast<long long>(budget->limit),
+			budget->opcodes ? "opcodes" : "lines");
+	}
+	return -1;
+}
+
+// Approximates the memory a session namespace keeps alive. Modules and classes are shared with the rest of the
+// interpreter and not counted.
+static const char* namespaceSizeSource = R"(
+import gc
+import sys
+import types
+
+def namespace_size(namespace):
+    seen = {id(namespace), id(namespace.get('__builtins__'))}
+    pending = [value for name, value in namespace.items() if name != '__builtins__']
+    total = sys.getsizeof(namespace)
+    while pending:
+        obj = pending.pop()
+        if id(obj) in seen or isinstance(obj, (types.ModuleType, type)):
+            continue
+        seen.add(id(obj))
+        total += sys.getsizeof(obj, 0)
+        pending.extend(gc.get_referents(obj))
+    return total
+)";
+
+// True on a free-threaded (3.13t) build that actually runs without the GIL. It can be re-enabled at runtime,
+// by PYTHON_GIL=1 or by importing an extension that does not declare free-threading support.
+static bool gilDisabled() {
+#ifdef Py_GIL_DISABLED
+	PyObject* isGilEnabled = PySys_GetObject("_is_gil_enabled"); // Borrowed
+	if (!isGilEnabled)
+		return true;
+
+	PyObject* enabled = PyObject_CallNoArgs(isGilEnabled);
+	const bool disabled = enabled == Py_False;
+	Py_XDECREF(enabled);
+	PyErr_Clear();
+	return disabled;
+#else
+	return false;
+#endif
+}
+
+// Attaches how long the execution waited for a pool thread. Called from inside the pool task.
+static PythonResult withTaskTiming(PythonResult result) {
+	const InterpreterPool::TaskTiming timing = InterpreterPool::currentTaskTiming();
+	result.setQueueStats(timing.queueDepth, timing.queueWaitTime / 1000);
+	return result;
+}
+
+static ResourceUsage usageSince(const ResourceUsage& before, const ResourceUsage& after) {
+	ResourceUsage usage = after;
+	usage.available = before.available && after.available;
+	usage.userCpuTime -= before.userCpuTime;
+	usage.systemCpuTime -= before.systemCpuTime;
+	usage.voluntaryContextSwitches -= before.voluntaryContextSwitches;
+	usage.involuntaryContextSwitches -= before.involuntaryContextSwitches;
+	usage.blockInputOperations -= before.blockInputOperations;
+	usage.blockOutputOperations -= before.blockOutputOperations;
+	return usage; // Peak RSS stays the process-wide high-water mark
+}
 
 // Definition of the Impl class inside PythonRunner.cpp
 class PythonRunner::Impl {
@@ -16,7 +409,7 @@ public:
 	Impl(QObject* parent);
 	~Impl();
 
-	PythonResult runScript(const QString& script, const QVariantList& arguments, int timeout);
+	PythonResult runScript(const QString& executionId, const QString& script, const QVariantList& arguments, int timeout);
 	void cancel();
 	PythonResult checkSyntax(const QString& script);
 
@@ -25,63 +418,165 @@ public:
 		QFutureWatcher<PythonResult>* watcher;
 		QTimer* timeoutTimer;
 		std::atomic<bool> isCancelled;
+		std::atomic<bool> isTimedOut{ false };
+		qint64 memoryLimit = -1; // Quota for the script's Python allocations, -1 for none
+
+		// Where the script runs while it executes; guarded by runningMutex, taken with the interpreter's GIL held
+		std::mutex runningMutex;
+		std::atomic<PyInterpreterState*> interpreter{ nullptr };
+		unsigned long threadId = 0;
+	};
+
+	/**
+	 * @brief Runs a script in the current interpreter. The caller holds its GIL.
+	 * @param sessionGlobals Namespace of a session to run in and keep; fresh globals are used when null.
+	 * @param sessionQuota Quota of that session, charged instead of a quota for this execution alone.
+	 */
+	PythonResult execute(const QString& executionId, const QString& script, const QVariantList& arguments, PyObject* sessionGlobals = nullptr,
+		ScriptExecutionContext* context = nullptr, MemoryQuota* sessionQuota = nullptr);
+
+	/**
+	 * @brief Adds the bundled environment to sys.path of the current interpreter. The caller holds its GIL.
+	 */
+	void configureInterpreter() const;
+
+	bool isFreeThreaded() const;
+
+	/**
+	 * @brief Returns a fresh globals dict for one execution, copied from the current interpreter's template.
+	 * The template is built on first use, and again after the preimported modules changed. The caller holds the GIL.
+	 */
+	PyObject* newGlobals();
+	void setPreimportedModules(const QStringList& modules);
+
+	/**
+	 * @brief A namespace that outlives single executions. It lives in the interpreter of one pool worker,
+	 * and all of its runs are pinned to that worker, which also serializes them.
+	 */
+	struct Session {
+		QString sessionId;
+		int worker = 0;
+		int idleTimeout = -1;
+		qint64 memoryLimit = -1;
+		std::unique_ptr<MemoryQuota> quota; // Charged by every run while the allocator hooks are installed
+		PyObject* globals = nullptr; // Only touched on the worker's thread
+		int pendingRuns = 0; // Runs submitted but not finished; idle eviction waits for them
 	};
 
+	bool openSession(const QString& sessionId, int idleTimeout, qint64 memoryLimit);
+	QFuture<PythonResult> runInSession(const QString& sessionId, const QString& executionId, const QString& script, const QVariantList& arguments);
+	bool closeSession(const QString& sessionId, const QString& reason = QString());
+	bool hasSession(const QString& sessionId);
+
+	/**
+	 * @brief Estimated bytes held by a namespace of the current interpreter, -1 if unknown. The caller holds the GIL.
+	 */
+	qint64 namespaceSize(PyObject* globals);
+
+	InterpreterPool* interpreterPool();
+	void resetInterpreterPool(int size, bool ownGil);
+	ExecutorStats executorStats();
+
+	/**
+	 * @brief Raises ExecutionCancelled in the thread running the context's script, or marks a queued one as cancelled.
+	 * The caller holds no GIL and none of the runner's mutexes, since it waits for the script's GIL.
+	 */
+	void interruptExecution(const std::shared_ptr<ScriptExecutionContext>& context);
+
 	QString getDefaultEnvPath() const;
 
 	QString getSitePackagesPath() const;
 	QString getLibPath() const;
 	QString getDLLsPath() const;
 
-	QMap<QString, ScriptExecutionContext*> executions;
+	QMap<QString, std::shared_ptr<ScriptExecutionContext>> executions; // Shared with cancel() while it interrupts
 	QMutex executionsMutex;
 
 
 	// In PythonRunner::Impl
 	void cancel(const QString& executionId);
 
+	std::atomic<qint64> outputMemoryLimit{ -1 };
+
+	CodeCache codeCache;
+
+	std::atomic<qint64> budgetLimit{ -1 };
+	std::atomic<BudgetUnit> budgetUnit{ BudgetUnit::Lines };
+
+	std::atomic<double> profileSampleRate{ 0 };
+	std::atomic<int> profileInterval{ 10 };
+
 private:
 	QObject* parentObject; // Store parent QObject
 
-	PyObject* sysModule;
-	PyObject* ioModule;
-	PyObject* stringIOClass;
-	PyObject* getValueMethod;
+	PyThreadState* mainThreadState; // Released after initialization so pool threads can take the GIL; never restored
+
+	bool freeThreaded; // Scripts run concurrently in the main interpreter
+
+	// Modules imported into the globals template; every interpreter keeps its own template
+	QStringList preimportedModules;
+	std::atomic<int> templateGeneration{ 0 };
+	QMutex templateMutex;
+
+	PyObject* buildGlobalsTemplate();
+
+	QHash<QString, std::shared_ptr<Session>> sessions;
+	QMutex sessionsMutex;
+	int nextSessionWorker = 0;
+	TimerWheel* idleSessions; // Idle deadline per session, lives on the runner's thread
+
+	/**
+	 * @brief Frees the namespace on the session's worker once its queued runs are done.
+	 */
+	void releaseSession(InterpreterPool* sessionPool, const std::shared_ptr<Session>& session);
+	QStringList releaseAllSessions(InterpreterPool* sessionPool);
+
+	std::shared_ptr<InterpreterPool> pool; // Shared with interruptExecution() while it is attached to an interpreter
+	int poolSize;
+	bool poolOwnGil;
+	QMutex poolMutex;
 };
 
 // Constructor
 PythonRunner::Impl::Impl(QObject* parent)
-	:  parentObject(parent),
-	sysModule(nullptr), ioModule(nullptr), stringIOClass(nullptr), getValueMethod(nullptr) {
+	: parentObject(parent), mainThreadState(nullptr), freeThreaded(false), poolSize(qMax(1, QThread::idealThreadCount())), poolOwnGil(true) {
+
+	idleSessions = new TimerWheel(100, 512, parent);
+	QObject::connect(idleSessions, &TimerWheel::expired, parent, [this](const QString& sessionId) {
+		closeSession(sessionId, QStringLiteral("Session was idle for too long."));
+		});
 
 	if (!Py_IsInitialized()) {
 		Py_Initialize();
+		mainThreadState = PyEval_SaveThread();
 	}
 
 	PyGILState_STATE gstate = PyGILState_Ensure();
+	configureInterpreter();
+	freeThreaded = gilDisabled();
+	PyGILState_Release(gstate);
+}
 
-	sysModule = PyImport_ImportModule("sys");
-	ioModule = PyImport_ImportModule("io");
-	if (sysModule && ioModule) {
+bool PythonRunner::Impl::isFreeThreaded() const {
+	return freeThreaded;
+}
 
-		stringIOClass = PyObject_GetAttrString(ioModule, "StringIO");
-		getValueMethod = PyUnicode_FromString("getvalue");
+// Destructor
+PythonRunner::Impl::~Impl() {
+	// Sub-interpreters have to end before the main interpreter is touched again
+	releaseAllSessions(pool.get());
+	pool.reset();
 
+	// Python is never finalized, so the GIL stays released for the next runner and its pool threads
+}
 
-		if (!stringIOClass || !getValueMethod)
-		{
-			qCritical() << "Failed to intialize io";
-		}
-	}
-	else {
-		qCritical() << "Failed to initialize Python modules.";
-	}
-	PyObject* sysPath = PyObject_GetAttrString(sysModule, "path");
+void PythonRunner::Impl::configureInterpreter() const {
+	PyObject* sysPath = PySys_GetObject("path"); // Borrowed
 	if (!sysPath || !PyList_Check(sysPath)) {
 		qCritical() << "Failed to access sys.path.";
-		Py_XDECREF(sysPath);
-		Py_DECREF(sysModule);
+		return;
 	}
+
 	QStringList paths = { getSitePackagesPath(), getLibPath(), getDLLsPath(), getDefaultEnvPath() };
 	for (const QString& path : paths) {
 		PyObject* pyPath = PyUnicode_FromString(path.toUtf8().constData());
@@ -91,180 +586,624 @@ PythonRunner::Impl::Impl(QObject* parent)
 		}
 		else {
 			qWarning() << "Failed to append path to sys.path:" << path;
+			PyErr_Clear();
 		}
 	}
-	Py_DECREF(sysPath);
-	Py_DECREF(sysModule);
 
-	PyGILState_Release(gstate);
+	if (!ensureOutputRouters()) {
+		qWarning() << "Failed to install the output routers.";
+		PyErr_Clear();
+	}
+
+	if (!installEmbedpythonModule()) {
+		qWarning() << "Failed to install the embedpython module.";
+		PyErr_Clear();
+	}
 }
 
-// Destructor
-PythonRunner::Impl::~Impl() {
-	PyGILState_STATE gstate = PyGILState_Ensure();
-	Py_XDECREF(sysModule);
-	Py_XDECREF(ioModule);
-	Py_XDECREF(stringIOClass);
-	Py_XDECREF(getValueMethod);
-	PyGILState_Release(gstate);
+InterpreterPool* PythonRunner::Impl::interpreterPool() {
+	QMutexLocker locker(&poolMutex);
+	if (!pool) {
+		// Without a GIL the threads already run in parallel and can share loaded modules, so sub-interpreters
+		// would only add per-interpreter import costs
+		pool = std::make_shared<InterpreterPool>(poolSize, poolOwnGil && !freeThreaded, [this]() {
+			configureInterpreter();
+			Py_XDECREF(newGlobals()); // Imports the template modules before the first script arrives
+			});
+	}
+	return pool.get();
+}
+
+PyObject* PythonRunner::Impl::buildGlobalsTemplate() {
+	PyObject* globals = PyDict_New();
+	if (!globals)
+		return nullptr;
+
+	PyObject* mainName = PyUnicode_FromString("__main__");
+	PyDict_SetItemString(globals, "__name__", mainName);
+	Py_XDECREF(mainName);
+	PyDict_SetItemString(globals, "__builtins__", PyEval_GetBuiltins());
+
+	QStringList modules;
+	{
+		QMutexLocker locker(&templateMutex);
+		modules = preimportedModules;
+	}
+
+	for (const QString& name : modules) {
+		PyObject* module = PyImport_ImportModule(name.toUtf8().constData());
+		if (!module) {
+			qWarning() << "Failed to preimport module:" << name;
+			PyErr_Clear();
+			continue;
+		}
+		Py_DECREF(module);
+
+		// Bind like "import a.b" does: the submodule is loaded, the top-level package gets the name
+		const QString topLevel = name.section('.', 0, 0);
+		PyObject* package = PyImport_ImportModule(topLevel.toUtf8().constData());
+		if (package) {
+			PyDict_SetItemString(globals, topLevel.toUtf8().constData(), package);
+			Py_DECREF(package);
+		}
+		else {
+			PyErr_Clear();
+		}
+	}
+	return globals;
+}
+
+PyObject* PythonRunner::Impl::newGlobals() {
+	// Objects cannot cross interpreters, so the template lives in the current interpreter's state dict
+	PyObject* interpreterDict = PyInterpreterState_GetDict(PyInterpreterState_Get()); // Borrowed
+	const int generation = templateGeneration.load();
+
+	PyObject* globalsTemplate = interpreterDict ? PyDict_GetItemString(interpreterDict, "EmbedPython.globalsTemplate") : nullptr;
+	PyObject* builtFor = interpreterDict ? PyDict_GetItemString(interpreterDict, "EmbedPython.templateGeneration") : nullptr;
+	if (!globalsTemplate || !builtFor || PyLong_AsLong(builtFor) != generation) {
+		PyObject* rebuilt = buildGlobalsTemplate();
+		if (!rebuilt)
+			return nullptr;
+
+		if (interpreterDict) {
+			PyObject* generationObj = PyLong_FromLong(generation);
+			PyDict_SetItemString(interpreterDict, "EmbedPython.globalsTemplate", rebuilt);
+			PyDict_SetItemString(interpreterDict, "EmbedPython.templateGeneration", generationObj);
+			Py_XDECREF(generationObj);
+		}
+		PyObject* globals = PyDict_Copy(rebuilt);
+		Py_DECREF(rebuilt);
+		return globals;
+	}
+
+	// A shallow copy shares the module objects, so nothing is imported again
+	return PyDict_Copy(globalsTemplate);
+}
+
+void PythonRunner::Impl::setPreimportedModules(const QStringList& modules) {
+	{
+		QMutexLocker locker(&templateMutex);
+		preimportedModules = modules;
+	}
+	++templateGeneration; // Interpreters rebuild their template before the next execution
+}
+
+void PythonRunner::Impl::resetInterpreterPool(int size, bool ownGil) {
+	QStringList closed;
+	{
+		QMutexLocker locker(&poolMutex);
+		poolSize = qMax(1, size);
+		poolOwnGil = ownGil;
+
+		// Session namespaces belong to the old interpreters
+		closed = releaseAllSessions(pool.get());
+		pool.reset(); // Waits for queued scripts; the next execution starts the new pool
+	}
+
+	for (const QString& sessionId : closed) {
+		idleSessions->cancel(sessionId);
+		emit static_cast<PythonRunner*>(parentObject)->sessionClosed(sessionId, QStringLiteral("The interpreter pool was reset."));
+	}
+}
+
+qint64 PythonRunner::Impl::namespaceSize(PyObject* globals) {
+	PyObject* interpreterDict = PyInterpreterState_GetDict(PyInterpreterState_Get()); // Borrowed
+	if (!interpreterDict)
+		return -1;
+
+	PyObject* sizeFunction = PyDict_GetItemString(interpreterDict, "EmbedPython.namespaceSize"); // Borrowed
+	if (!sizeFunction) {
+		PyObject* namespaceDict = PyDict_New();
+		PyDict_SetItemString(namespaceDict, "__builtins__", PyEval_GetBuiltins());
+		PyObject* definition = PyRun_String(namespaceSizeSource, Py_file_input, namespaceDict, namespaceDict);
+		Py_XDECREF(definition);
+		sizeFunction = PyDict_GetItemString(namespaceDict, "namespace_size");
+		if (sizeFunction) {
+			PyDict_SetItemString(interpreterDict, "EmbedPython.namespaceSize", sizeFunction);
+		}
+		Py_DECREF(namespaceDict); // The interpreter dict keeps the function alive
+		if (!sizeFunction) {
+			PyErr_Clear();
+			return -1;
+		}
+	}
+
+	PyObject* sizeObj = PyObject_CallOneArg(sizeFunction, globals);
+	const qint64 size = sizeObj ? PyLong_AsLongLong(sizeObj) : -1;
+	Py_XDECREF(sizeObj);
+	PyErr_Clear();
+	return size;
+}
+
+bool PythonRunner::Impl::openSession(const QString& sessionId, int idleTimeout, qint64 memoryLimit) {
+	InterpreterPool* sessionPool = interpreterPool();
+
+	auto session = std::make_shared<Session>();
+	session->sessionId = sessionId;
+	session->idleTimeout = idleTimeout;
+	session->memoryLimit = memoryLimit;
+	if (MemoryQuota::isInstalled()) {
+		// Blocks a run leaves in the namespace stay charged until a later run or the session frees them
+		session->quota = std::make_unique<MemoryQuota>(memoryLimit);
+	}
+	{
+		QMutexLocker locker(&sessionsMutex);
+		if (sessions.contains(sessionId))
+			return false;
+
+		session->worker = nextSessionWorker++ % sessionPool->size();
+		sessions.insert(sessionId, session);
+	}
+
+	sessionPool->submitTo(session->worker, [this, session]() {
+		session->globals = newGlobals();
+		if (!session->globals) {
+			qWarning() << "Failed to create the namespace of session" << session->sessionId;
+			PyErr_Clear();
+		}
+		});
+
+	if (idleTimeout > 0) {
+		idleSessions->schedule(sessionId, idleTimeout);
+	}
+	return true;
+}
+
+QFuture<PythonResult> PythonRunner::Impl::runInSession(const QString& sessionId, const QString& executionId, const QString& script, const QVariantList& arguments) {
+	auto promise = std::make_shared<QPromise<PythonResult>>();
+	QFuture<PythonResult> future = promise->future();
+	promise->start();
+
+	std::shared_ptr<Session> session;
+	{
+		QMutexLocker locker(&sessionsMutex);
+		session = sessions.value(sessionId);
+		if (session) {
+			++session->pendingRuns;
+		}
+	}
+
+	if (!session) {
+		PythonResult result(executionId, false, "", "No session with ID: " + sessionId);
+		result.setErrorCode(static_cast<int>(ExecutionError::Rejected));
+		promise->addResult(result);
+		promise->finish();
+		return future;
+	}
+
+	idleSessions->cancel(sessionId);
+
+	interpreterPool()->submitTo(session->worker, [this, session, executionId, script, arguments, promise]() {
+		if (!session->globals) {
+			promise->addResult(PythonResult(executionId, false, "", "Session " + session->sessionId + " is closed."));
+			promise->finish();
+			return;
+		}
+
+		PythonResult result = withTaskTiming(execute(executionId, script, arguments, session->globals, nullptr, session->quota.get()));
+
+		// With the hooks installed the session's quota refused the allocation that would have crossed the limit.
+		// Without them only an estimate of what the namespace references after the run is available.
+		bool overLimit = false;
+		QString limitMessage;
+		if (session->quota) {
+			overLimit = session->quota->limitHit();
+			limitMessage = QString("\nSession exceeded its memory quota of %1 bytes; the session was closed.").arg(session->memoryLimit);
+		}
+		else if (session->memoryLimit >= 0) {
+			const qint64 size = namespaceSize(session->globals);
+			overLimit = size > session->memoryLimit;
+			limitMessage = QString("\nSession namespace holds about %1 bytes, above its limit of %2; the session was closed.")
+				.arg(size).arg(session->memoryLimit);
+		}
+
+		if (overLimit) {
+			// Also when the script caught the MemoryError, the session cannot continue past its limit
+			PythonResult limited(executionId, false, result.getOutput(), result.getErrorOutput() + limitMessage, result.getExecutionTime());
+			limited.setErrorCode(static_cast<int>(ExecutionError::MemoryLimit));
+			limited.setResourceUsage(result.getResourceUsage());
+			result = limited;
+
+			// Drop the namespace right away instead of holding the memory until the runner's thread catches up
+			PyDict_Clear(session->globals);
+			Py_CLEAR(session->globals);
+		}
+
+		QMetaObject::invokeMethod(parentObject, [this, session, overLimit]() {
+			bool idle = false;
+			{
+				QMutexLocker locker(&sessionsMutex);
+				idle = --session->pendingRuns == 0 && sessions.value(session->sessionId) == session;
+			}
+
+			if (overLimit) {
+				closeSession(session->sessionId, QStringLiteral("Session exceeded its memory limit."));
+			}
+			else if (idle && session->idleTimeout > 0) {
+				idleSessions->schedule(session->sessionId, session->idleTimeout);
+			}
+			}, Qt::QueuedConnection);
+
+		promise->addResult(result);
+		promise->finish();
+		});
+
+	return future;
+}
+
+bool PythonRunner::Impl::closeSession(const QString& sessionId, const QString& reason) {
+	std::shared_ptr<Session> session;
+	{
+		QMutexLocker locker(&sessionsMutex);
+		session = sessions.take(sessionId);
+	}
+	if (!session)
+		return false;
+
+	idleSessions->cancel(sessionId);
+	releaseSession(interpreterPool(), session);
+
+	if (!reason.isEmpty()) {
+		emit static_cast<PythonRunner*>(parentObject)->sessionClosed(sessionId, reason);
+	}
+	return true;
+}
+
+bool PythonRunner::Impl::hasSession(const QString& sessionId) {
+	QMutexLocker locker(&sessionsMutex);
+	return sessions.contains(sessionId);
+}
+
+void PythonRunner::Impl::releaseSession(InterpreterPool* sessionPool, const std::shared_ptr<Session>& session) {
+	if (!sessionPool)
+		return;
+
+	sessionPool->submitTo(session->worker, [session]() {
+		if (session->globals) {
+			PyDict_Clear(session->globals);
+			Py_CLEAR(session->globals);
+		}
+		});
+}
+
+QStringList PythonRunner::Impl::releaseAllSessions(InterpreterPool* sessionPool) {
+	QMutexLocker locker(&sessionsMutex);
+	for (const std::shared_ptr<Session>& session : std::as_const(sessions)) {
+		releaseSession(sessionPool, session);
+	}
+
+	QStringList closed = sessions.keys();
+	sessions.clear();
+	return closed;
 }
 
 // Implement runScript
-PythonResult PythonRunner::Impl::runScript(const QString& script, const QVariantList& arguments, int timeout) {
+PythonResult PythonRunner::Impl::runScript(const QString& executionId, const QString& script, const QVariantList& arguments, int timeout) {
 	Q_UNUSED(timeout);
 	if (script.isEmpty()) {
-		return PythonResult(false, "", "Script is Empty.");
+		return PythonResult(executionId, false, "", "Script is Empty.");
+	}
+
+	// Runs on the executor like asynchronous scripts, so the calling thread never has to take a GIL
+	auto promise = std::make_shared<QPromise<PythonResult>>();
+	QFuture<PythonResult> future = promise->future();
+	promise->start();
+
+	interpreterPool()->submit([this, executionId, script, arguments, promise]() {
+		try {
+			promise->addResult(withTaskTiming(execute(executionId, script, arguments)));
+		}
+		catch (...) {
+			promise->addResult(PythonResult(executionId, false, "", "An unknown error occurred."));
+		}
+		promise->finish();
+		});
+
+	return future.result();
+}
+
+PythonResult PythonRunner::Impl::execute(const QString& executionId, const QString& script, const QVariantList& arguments, PyObject* sessionGlobals,
+	ScriptExecutionContext* context, MemoryQuota* sessionQuota) {
+	if (script.isEmpty()) {
+		return PythonResult(executionId, false, "", "Script is Empty.");
 	}
 
 	QElapsedTimer timer;
 	timer.start();
+	const ResourceUsage usageBefore = sampleThreadUsage();
 
-	PyGILState_STATE gstate = PyGILState_Ensure();
+	// Every execution gets its own globals, so no state leaks into later runs and concurrent runs stay apart
+	PyObject* globals = sessionGlobals ? Py_NewRef(sessionGlobals) : newGlobals();
+	if (!globals) {
+		PyErr_Clear();
+		return PythonResult(executionId, false, "", "Failed to create the globals for the script.");
+	}
 
-	try {
-		// Create new StringIO objects for stdout and stderr
-		PyObject* stringIOOut = PyObject_CallObject(stringIOClass, nullptr);
-		PyObject* stringIOErr = PyObject_CallObject(stringIOClass, nullptr);
-
-		if (!stringIOOut || !stringIOErr) {
-			Py_XDECREF(stringIOOut);
-			Py_XDECREF(stringIOErr);
-			PyGILState_Release(gstate);
-			return PythonResult(false, "", "Failed to create StringIO objects.");
-		}
-
-		PyObject_SetAttrString(sysModule, "stdout", stringIOOut);
-		PyObject_SetAttrString(sysModule, "stderr", stringIOErr);
-
-		PyObject* mainModule = PyImport_AddModule("__main__");
-		PyObject* mainDict = PyModule_GetDict(mainModule);
-
-		if (!arguments.isEmpty()) {
-			for (int i = 0; i < arguments.size(); ++i) {
-				QString varName = QString("arg%1").arg(i + 1);
-				PyObject* argPy = DataConverter::QVariantToPyObject(arguments[i]);
-				if (!argPy) {
-					Py_DECREF(stringIOOut);
-					Py_DECREF(stringIOErr);
-					PyGILState_Release(gstate);
-					return PythonResult(false, "", "Failed to convert argument to PyObject.");
-				}
-				PyDict_SetItemString(mainDict, varName.toUtf8().constData(), argPy);
-				Py_DECREF(argPy);
-			}
-		}
+	// Output beyond the memory limit goes to a temporary file instead of the result
+	OutputSpool output(outputMemoryLimit.load());
+	OutputSpool errorOutput(outputMemoryLimit.load());
 
-		PyObject* resultObj = PyRun_String(script.toUtf8().constData(), Py_file_input, mainDict, mainDict);
+	// The routers stay installed as sys.stdout/sys.stderr; they only need to know where this thread's writes go,
+	// so overlapping executions on other threads keep their output apart
+	if (!ensureOutputRouters()) {
+		PyErr_Clear();
+		Py_DECREF(globals);
+		return PythonResult(executionId, false, "", "Failed to install the output routers.");
+	}
+	std::optional<OutputCapture> capture(std::in_place, &output, &errorOutput);
 
+	std::optional<NumericBuffer> resultBuffer;
+	capturedResult = &resultBuffer;
 
-		QString outputStr, errorOutputStr;
-		bool success = (resultObj != nullptr);
+	// Without a limit the quota only measures, which is free once the hooks are installed anyway
+	std::optional<MemoryQuota> executionQuota;
+	MemoryQuota* quota = sessionQuota;
+	if (!quota && MemoryQuota::isInstalled()) {
+		quota = &executionQuota.emplace(context ? context->memoryLimit : -1);
+	}
 
-		if (resultObj) {
-			Py_DECREF(resultObj);
-		}
-		else {
-			PyErr_Print();
-			errorOutputStr = "Script execution failed.";
+	// Counting work instead of time gives the same verdict for the same script on a busy and an idle machine
+	std::optional<ExecutionBudget> budget;
+	if (budgetLimit.load() >= 0) {
+		budget.emplace();
+		budget->limit = budgetLimit.load();
+		budget->opcodes = budgetUnit.load() == BudgetUnit::Opcodes;
+	}
+
+	PyObject* resultObj = nullptr;
+	QString profile;
+	bool argumentsValid = true;
+	for (int i = 0; i < arguments.size(); ++i) {
+		QString varName = QString("arg%1").arg(i + 1);
+		PyObject* argPy = DataConverter::QVariantToPyObject(arguments[i]);
+		if (!argPy) {
+			argumentsValid = false;
+			break;
 		}
+		PyDict_SetItemString(globals, varName.toUtf8().constData(), argPy);
+		Py_DECREF(argPy);
+	}
 
-		PyObject* outputObj = PyObject_CallMethodObjArgs(stringIOOut, getValueMethod, NULL);
-		PyObject* errorOutputObj = PyObject_CallMethodObjArgs(stringIOErr, getValueMethod, NULL);
+	if (argumentsValid) {
+		if (context) {
+			// From here on cancel() can raise ExecutionCancelled in this thread
+			std::lock_guard<std::mutex> running(context->runningMutex);
+			context->threadId = PyThread_get_thread_ident();
+			context->interpreter.store(PyInterpreterState_Get());
+		}
 
-		if (outputObj) {
-			outputStr = QString::fromUtf8(PyUnicode_AsUTF8(outputObj));
-			Py_DECREF(outputObj);
+		// A cancel() that came in after the task was dequeued found nothing to interrupt yet
+		PyObject* cancelledType = context && context->isCancelled.load() ? executionCancelledType() : nullptr;
+		if (cancelledType) {
+			PyErr_SetNone(cancelledType);
 		}
 		else {
-			qDebug() << "Failed to capture output.";
-			PyErr_Print();
-			errorOutputStr += "Failed to capture output.";
+			// Only a fraction of executions is profiled, so it can stay on in production
+			std::optional<SamplingProfiler> profiler;
+			const double sampleRate = profileSampleRate.load();
+			if (sampleRate > 0 && QRandomGenerator::global()->generateDouble() < sampleRate) {
+				profiler.emplace(profileInterval.load());
+			}
+
+			if (budget) {
+				currentBudget = &*budget;
+				PyEval_SetTrace(chargeBudget, nullptr);
+			}
+
+			// Repeated scripts skip tokenizing and compiling. The cache's code objects are shared,
+			// so they are created before the quota is active and never charged to this execution.
+			PyObject* code = codeCache.get(script.toUtf8());
+			if (code) {
+				// Allocations of this thread count against the quota until the script returns
+				if (quota) {
+					quota->activate();
+				}
+				resultObj = PyEval_EvalCode(code, globals, globals);
+				if (quota) {
+					quota->deactivate();
+				}
+				Py_DECREF(code);
+			}
+
+			if (profiler || budget) {
+				// Keeps the script's exception across removing the trace and the GIL release in stop()
+				PyObject* type, * value, * traceback;
+				PyErr_Fetch(&type, &value, &traceback);
+				if (budget) {
+					PyEval_SetTrace(nullptr, nullptr);
+					currentBudget = nullptr;
+				}
+				if (profiler) {
+					profile = profiler->stop();
+				}
+				PyErr_Clear();
+				PyErr_Restore(type, value, traceback);
+			}
+		}
+	}
+
+	// Only a cancellation that actually stopped the script counts; one that arrived after it returned is dropped
+	bool cancelled = false;
+	if (context && argumentsValid) {
+		std::lock_guard<std::mutex> running(context->runningMutex);
+		PyObject* cancelledType = executionCancelledType();
+		cancelled = !resultObj && cancelledType && PyErr_ExceptionMatches(cancelledType);
+		if (context->isCancelled.load() && !cancelled) {
+			PyThreadState_SetAsyncExc(context->threadId, nullptr); // Would otherwise go off in the thread's next task
 		}
+		context->threadId = 0;
+		context->interpreter.store(nullptr);
+	}
 
-		if (errorOutputObj) {
-		
-			errorOutputStr += QString::fromUtf8(PyUnicode_AsUTF8(errorOutputObj));
-			Py_DECREF(errorOutputObj);
+	bool success = (resultObj != nullptr);
+	int errorCode = static_cast<int>(ExecutionError::None);
+
+	if (resultObj) {
+		Py_DECREF(resultObj);
+	}
+	else if (cancelled) {
+		PyErr_Clear();
+		const bool timedOut = context->isTimedOut.load();
+		errorCode = static_cast<int>(timedOut ? ExecutionError::Timeout : ExecutionError::Cancelled);
+		errorOutput.append(timedOut ? QByteArrayLiteral("Script execution timed out.") : QByteArrayLiteral("Execution was cancelled."));
+	}
+	else if (argumentsValid && PyErr_ExceptionMatches(PyExc_SystemExit)) {
+		// PyErr_Print() would exit the host process; sys.exit() only ends the script, like in a pooled worker
+		PyObject* type, * value, * traceback;
+		PyErr_Fetch(&type, &value, &traceback);
+		PyErr_NormalizeException(&type, &value, &traceback);
+		PyObject* code = value ? PyObject_GetAttrString(value, "code") : nullptr;
+		PyErr_Clear();
+
+		long exitCode = 0;
+		if (code && PyLong_Check(code)) {
+			exitCode = PyLong_AsLong(code);
+			PyErr_Clear();
 		}
-		else {
-			qDebug() << "Failed to capture error output.";
-			PyErr_Print();
-			errorOutputStr += "Failed to capture output.";
+		else if (code && code != Py_None) {
+			// sys.exit("message") prints the message and exits with 1
+			PyObject* message = PyObject_Str(code);
+			const char* text = message ? PyUnicode_AsUTF8(message) : nullptr;
+			if (text) {
+				errorOutput.append(QByteArray(text) + '\n');
+			}
+			Py_XDECREF(message);
+			PyErr_Clear();
+			exitCode = 1;
 		}
 
+		success = exitCode == 0;
+		if (!success) {
+			errorOutput.append(QString("Script exited with code %1.").arg(exitCode).toUtf8());
+		}
+		Py_XDECREF(code);
+		Py_XDECREF(type);
+		Py_XDECREF(value);
+		Py_XDECREF(traceback);
+	}
+	else if (!argumentsValid) {
+		PyErr_Print(); // Names the argument type DataConverter could not convert
+		errorOutput.append(QByteArrayLiteral("Failed to convert argument to PyObject."));
+	}
+	else {
+		PyErr_Print(); // Goes through the stderr router into errorOutput
+		errorOutput.append(QByteArrayLiteral("Script execution failed."));
 
-		Py_DECREF(stringIOOut);
-		Py_DECREF(stringIOErr);
+		if (quota && quota->limitHit()) {
+			errorCode = static_cast<int>(ExecutionError::MemoryLimit);
+			errorOutput.append(QString("\nExceeded the memory quota of %1 bytes.").arg(quota->byteLimit()).toUtf8());
+		}
+		else if (budget && budget->exceeded) {
+			errorCode = static_cast<int>(ExecutionError::BudgetExceeded);
+		}
+	}
 
-		PyGILState_Release(gstate);
+	// Output of objects torn down with the globals is not part of the result
+	capture.reset();
+	capturedResult = nullptr;
 
-		qint64 elapsedTime = timer.elapsed();
-		return PythonResult(success, outputStr, errorOutputStr, QJsonObject(), elapsedTime);
+	// Functions defined by the script reference their globals, so clearing breaks the cycle and frees the run's state now
+	if (!sessionGlobals) {
+		PyDict_Clear(globals);
+	}
+	Py_DECREF(globals);
+
+	qint64 elapsedTime = timer.elapsed();
+	PythonResult result(executionId, success, output.text(), errorOutput.text(), elapsedTime);
+	result.setErrorCode(errorCode);
+	ResourceUsage usage = usageSince(usageBefore, sampleThreadUsage());
+	if (quota) {
+		usage.peakAllocatedBytes = quota->peak();
 	}
-	catch (...) {
-		PyGILState_Release(gstate);
-		return PythonResult(false, "", "An unknown error occurred.");
+	if (budget) {
+		usage.executedUnits = budget->used;
 	}
+	result.setResourceUsage(usage);
+	result.setProfile(profile);
+	if (success && resultBuffer) {
+		result.setResultBuffer(*resultBuffer);
+	}
+	if (output.isSpilled()) {
+		result.setOutputFile(output.file(), output.size());
+	}
+	if (errorOutput.isSpilled()) {
+		result.setErrorOutputFile(errorOutput.file());
+	}
+	return result;
 }
 
 
 // Implement cancel
 void PythonRunner::Impl::cancel() {
-	for (auto context : executions) {
-		context->isCancelled.store(true);
-		PyGILState_STATE gstate = PyGILState_Ensure();
-		PyErr_SetInterrupt();
-		PyGILState_Release(gstate);
-	}
+	cancel(QString());
 }
 
 // Implement checkSyntax
 PythonResult PythonRunner::Impl::checkSyntax(const QString& script) {
 	if (script.isEmpty()) {
-		return PythonResult(false, "", "Script is empty.");
+		return PythonResult(QString(), false, "", "Script is empty.");
 	}
 
-	QElapsedTimer timer;
-	timer.start();
+	// Compiled on the executor like scripts are run, so the calling thread never has to take a GIL
+	auto promise = std::make_shared<QPromise<PythonResult>>();
+	QFuture<PythonResult> future = promise->future();
+	promise->start();
 
-	// Acquire Python GIL
-	PyGILState_STATE gstate = PyGILState_Ensure();
+	interpreterPool()->submit([this, script, promise]() {
+		QElapsedTimer timer;
+		timer.start();
 
-	try {
-		// Attempt to compile the script
-		PyObject* compiledCode = Py_CompileString(script.toUtf8().constData(), "<string>", Py_file_input);
+		// Attempt to compile the script; a valid one stays cached for the runs that follow
+		PyObject* compiledCode = codeCache.get(script.toUtf8());
 		if (compiledCode) {
 			// Compilation succeeded, syntax is correct
 			Py_DECREF(compiledCode);
-			PyGILState_Release(gstate);
-			qint64 elapsedTime = timer.elapsed();
-			return PythonResult(true, "", "", QJsonObject(), elapsedTime);
+			promise->addResult(PythonResult(QString(), true, "", "", timer.elapsed()));
+			promise->finish();
+			return;
 		}
-		else {
-			// Compilation failed, retrieve the error message
-			PyObject* type, * value, * traceback;
-			PyErr_Fetch(&type, &value, &traceback);
-			PyErr_NormalizeException(&type, &value, &traceback);
-			QString errorMsg = "Syntax error.";
-			if (value) {
-				PyObject* strExcValue = PyObject_Str(value);
-				if (strExcValue) {
-					errorMsg = QString::fromUtf8(PyUnicode_AsUTF8(strExcValue));
-					Py_DECREF(strExcValue);
-				}
+
+		// Compilation failed, retrieve the error message
+		PyObject* type, * value, * traceback;
+		PyErr_Fetch(&type, &value, &traceback);
+		PyErr_NormalizeException(&type, &value, &traceback);
+		QString errorMsg = "Syntax error.";
+		if (value) {
+			PyObject* strExcValue = PyObject_Str(value);
+			if (strExcValue) {
+				errorMsg = QString::fromUtf8(PyUnicode_AsUTF8(strExcValue));
+				Py_DECREF(strExcValue);
 			}
-			Py_XDECREF(type);
-			Py_XDECREF(value);
-			Py_XDECREF(traceback);
-			PyGILState_Release(gstate);
-			qint64 elapsedTime = timer.elapsed();
-			return PythonResult(false, "", errorMsg, QJsonObject(), elapsedTime);
+			PyErr_Clear();
 		}
-	}
-	catch (...) {
-		PyGILState_Release(gstate);
-		return PythonResult(false, "", "An unknown error occurred during syntax checking.");
-	}
+		Py_XDECREF(type);
+		Py_XDECREF(value);
+		Py_XDECREF(traceback);
+		promise->addResult(PythonResult(QString(), false, "", errorMsg, timer.elapsed()));
+		promise->finish();
+		});
+
+	return future.result();
 }
 
 // PythonRunner constructor and destructor
@@ -275,39 +1214,173 @@ PythonRunner::~PythonRunner() = default;
 
 // Forward public methods to the Impl
 PythonResult PythonRunner::runScript(const QString& script, const QVariantList& arguments, int timeout) {
-	return impl->runScript(script, arguments, timeout);
+	return impl->runScript(QString(), script, arguments, timeout);
+}
+
+void PythonRunner::setOutputMemoryLimit(qint64 bytes) {
+	impl->outputMemoryLimit.store(bytes);
+}
+
+void PythonRunner::setInterpreterPoolSize(int size, bool ownGil) {
+	impl->resetInterpreterPool(size, ownGil);
+}
+
+bool PythonRunner::isFreeThreaded() const {
+	return impl->isFreeThreaded();
+}
+
+ExecutorStats PythonRunner::executorStats() const {
+	return impl->executorStats();
+}
+
+ExecutorStats PythonRunner::Impl::executorStats() {
+	ExecutorStats stats;
+	QMutexLocker locker(&poolMutex);
+	if (pool) {
+		const InterpreterPool::Stats poolStats = pool->stats();
+		stats.threads = pool->size();
+		stats.queueDepth = poolStats.queueDepth;
+		stats.peakQueueDepth = poolStats.peakQueueDepth;
+		stats.startedTasks = poolStats.startedTasks;
+		stats.totalQueueWaitTime = poolStats.totalQueueWaitTime;
+		stats.totalGilWaitTime = poolStats.totalGilWaitTime;
+		stats.maxGilWaitTime = poolStats.maxGilWaitTime;
+	}
+	return stats;
+}
+
+void PythonRunner::setExecutionBudget(qint64 units, BudgetUnit unit) {
+	impl->budgetUnit.store(unit);
+	impl->budgetLimit.store(units);
+}
+
+void PythonRunner::setProfiling(double sampleRate, int interval) {
+	impl->profileSampleRate.store(qBound(0.0, sampleRate, 1.0));
+	impl->profileInterval.store(qMax(1, interval));
+}
+
+bool PythonRunner::enableMemoryQuotas() {
+	if (MemoryQuota::isInstalled())
+		return true;
+	if (Py_IsInitialized())
+		return false;
+
+	// The hooks have to be in place before the first object is allocated, but after the runtime's raw allocator is set up
+	PyPreConfig preconfig;
+	PyPreConfig_InitCompatConfig(&preconfig);
+	PyStatus status = Py_PreInitialize(&preconfig);
+	if (PyStatus_Exception(status)) {
+		qWarning() << "Failed to pre-initialize Python:" << (status.err_msg ? status.err_msg : "unknown error");
+		return false;
+	}
+	return MemoryQuota::install();
+}
+
+void PythonRunner::setCodeCacheCapacity(int scripts) {
+	impl->codeCache.setCapacity(scripts);
+}
+
+CodeCacheStats PythonRunner::codeCacheStats() const {
+	CodeCacheStats stats;
+	stats.hits = impl->codeCache.hits();
+	stats.misses = impl->codeCache.misses();
+	stats.evictions = impl->codeCache.evictions();
+	return stats;
+}
+
+void PythonRunner::setPreimportedModules(const QStringList& modules) {
+	impl->setPreimportedModules(modules);
+}
+
+bool PythonRunner::openSession(const QString& sessionId, int idleTimeout, qint64 memoryLimit) {
+	return impl->openSession(sessionId, idleTimeout, memoryLimit);
+}
+
+QFuture<PythonResult> PythonRunner::runInSession(const QString& sessionId, const QString& executionId, const QString& script, const QVariantList& arguments) {
+	return impl->runInSession(sessionId, executionId, script, arguments);
+}
+
+bool PythonRunner::closeSession(const QString& sessionId) {
+	return impl->closeSession(sessionId);
+}
+
+bool PythonRunner::hasSession(const QString& sessionId) const {
+	return impl->hasSession(sessionId);
 }
 
 
 // In PythonRunner::Impl
 void PythonRunner::Impl::cancel(const QString& executionId) {
-	QMutexLocker locker(&executionsMutex);
-	if (executionId.isEmpty()) {
-		// Cancel all scripts
-		for (auto context : executions) {
-			context->isCancelled.store(true);
-			PyGILState_STATE gstate = PyGILState_Ensure();
-			PyErr_SetInterrupt();
-			PyGILState_Release(gstate);
+	// Interrupting waits for the script's GIL, which must not happen under executionsMutex
+	QList<std::shared_ptr<ScriptExecutionContext>> targets;
+	{
+		QMutexLocker locker(&executionsMutex);
+		if (executionId.isEmpty()) {
+			// Cancel all scripts
+			targets = executions.values();
 		}
-	}
-	else {
-		// Cancel specific script
-		auto context = executions.value(executionId, nullptr);
-		if (context) {
-			context->isCancelled.store(true);
-			PyGILState_STATE gstate = PyGILState_Ensure();
-			PyErr_SetInterrupt();
-			PyGILState_Release(gstate);
+		else if (auto context = executions.value(executionId)) {
+			// Cancel specific script
+			targets.append(context);
 		}
-		else {
-			qWarning() << "No execution found with ID:" << executionId;
+	}
+
+	if (!executionId.isEmpty() && targets.isEmpty()) {
+		qWarning() << "No execution found with ID:" << executionId;
+	}
+	for (const auto& context : std::as_const(targets)) {
+		interruptExecution(context);
+	}
+}
+
+void PythonRunner::Impl::interruptExecution(const std::shared_ptr<ScriptExecutionContext>& context) {
+	context->isCancelled.store(true); // A queued execution sees this before it starts
+
+	// Keeps the pool, and with it the interpreter the script runs in, alive while we attach to it.
+	// A pool replaced in the meantime is destroyed once we let go of it.
+	std::shared_ptr<InterpreterPool> pinnedPool;
+	{
+		QMutexLocker poolLocker(&poolMutex);
+		pinnedPool = pool;
+	}
+	PyInterpreterState* interpreter = context->interpreter.load();
+	if (!pinnedPool || !interpreter)
+		return;
+
+	// The exception has to be raised holding the GIL of the script's interpreter, which may be a sub-interpreter
+	PyThreadState* threadState = PyThreadState_New(interpreter);
+	PyEval_RestoreThread(threadState);
+	{
+		std::lock_guard<std::mutex> running(context->runningMutex);
+		if (context->interpreter.load() == interpreter && context->threadId != 0) {
+			PyObject* cancelledType = executionCancelledType();
+			if (cancelledType) {
+				PyThreadState_SetAsyncExc(context->threadId, cancelledType);
+			}
+			PyErr_Clear();
 		}
 	}
+	PyThreadState_Clear(threadState);
+	PyThreadState_DeleteCurrent();
 }
 
-QFuture<PythonResult> PythonRunner::runScriptAsync(const QString& executionId, const QString& script, const QVariantList& arguments, int timeout) {
-	auto context = new Impl::ScriptExecutionContext();
+QFuture<PythonResult> PythonRunner::runScriptAsync(const QString& executionId, const QString& script, const QVariantList& arguments, int timeout,
+	const ExecutionLimits& limits) {
+	// Like ExecutionLimits for subprocesses, only a positive value is a limit
+	const qint64 memoryLimit = limits.memoryBytes > 0 ? limits.memoryBytes : -1;
+	if (memoryLimit > 0 && !MemoryQuota::isInstalled()) {
+		// Running without the quota would leave the host process unprotected
+		QPromise<PythonResult> rejected;
+		rejected.start();
+		PythonResult result(executionId, false, "", "Memory quotas are not enabled; call PythonRunner::enableMemoryQuotas() before Python is initialized.");
+		result.setErrorCode(static_cast<int>(ExecutionError::Rejected));
+		rejected.addResult(result);
+		rejected.finish();
+		return rejected.future();
+	}
+
+	auto context = std::make_shared<Impl::ScriptExecutionContext>();
+	context->memoryLimit = memoryLimit;
 	context->executionId = executionId;
 	context->isCancelled.store(false);
 	context->watcher = new QFutureWatcher<PythonResult>(this);
@@ -318,12 +1391,22 @@ QFuture<PythonResult> PythonRunner::runScriptAsync(const QString& executionId, c
 		impl->executions.insert(executionId, context);
 	}
 
-	// Start asynchronous execution
-	QFuture<PythonResult> future = QtConcurrent::run([this, script, arguments, context]() -> PythonResult {
+	// Start asynchronous execution on a pooled interpreter
+	auto promise = std::make_shared<QPromise<PythonResult>>();
+	QFuture<PythonResult> future = promise->future();
+	promise->start();
+
+	impl->interpreterPool()->submit([this, executionId, script, arguments, context, promise]() {
 		if (context->isCancelled.load()) {
-			return PythonResult(false, "", "Execution was cancelled.");
+			const bool timedOut = context->isTimedOut.load();
+			PythonResult result(executionId, false, "", timedOut ? "Script execution timed out." : "Execution was cancelled.");
+			result.setErrorCode(static_cast<int>(timedOut ? ExecutionError::Timeout : ExecutionError::Cancelled));
+			promise->addResult(result);
+		}
+		else {
+			promise->addResult(withTaskTiming(impl->execute(executionId, script, arguments, nullptr, context.get())));
 		}
-		return this->runScript(script, arguments);
+		promise->finish();
 		});
 
 	// Set the future to the watcher
@@ -336,6 +1419,7 @@ QFuture<PythonResult> PythonRunner::runScriptAsync(const QString& executionId, c
 		connect(context->timeoutTimer, &QTimer::timeout, this, [this, context]() {
 			if (!context->watcher->isFinished()) {
 				qWarning() << "Script execution timed out. Cancelling execution ID:" << context->executionId;
+				context->isTimedOut.store(true);
 				this->cancel(context->executionId);
 			}
 			});
@@ -356,8 +1440,7 @@ QFuture<PythonResult> PythonRunner::runScriptAsync(const QString& executionId, c
 		if (context->timeoutTimer) {
 			context->timeoutTimer->deleteLater();
 		}
-		context->watcher->deleteLater();
-		delete context;
+		context->watcher->deleteLater(); // Drops the connection, and with it this handler's reference to the context
 	});
 
 	return future;
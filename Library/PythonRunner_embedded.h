@@ -9,10 +9,41 @@
 #include <memory>
 #include <atomic>
 #include "PythonResult.h"
+#include "ProcessLimits.h"
 
 
 class PythonEnvironment;
 
+/**
+ * @brief Load of the threads executing embedded scripts. Times are in microseconds.
+ */
+struct ExecutorStats {
+	int threads = 0; // 0 until the first execution starts the pool
+	int queueDepth = 0; // Executions waiting for a thread
+	int peakQueueDepth = 0;
+	qint64 startedTasks = 0;
+	qint64 totalQueueWaitTime = 0;
+	qint64 totalGilWaitTime = 0; // Time threads blocked on the GIL before running a task
+	qint64 maxGilWaitTime = 0;
+};
+
+/**
+ * @brief What PythonRunner::setExecutionBudget() counts.
+ */
+enum class BudgetUnit {
+	Lines, // Source lines started, cheap enough to leave on
+	Opcodes // Bytecode instructions, finer but several times the tracing overhead
+};
+
+/**
+ * @brief Counters of the compiled-script cache behind runScriptAsync() and checkSyntax().
+ */
+struct CodeCacheStats {
+	qint64 hits = 0; // Scripts run or checked without compiling
+	qint64 misses = 0; // Scripts that had to be compiled
+	qint64 evictions = 0; // Scripts dropped from the cache; counted once, not per interpreter
+};
+
 class LIBRARY_EXPORT PythonRunner : public QObject
 {
 	Q_OBJECT
@@ -23,10 +54,114 @@ public:
 	PythonResult checkSyntax(const QString& script);
 	PythonResult runScript(const QString& script, const QVariantList& arguments = {}, int timeout = 0);
 	
-	QFuture<PythonResult> runScriptAsync(const QString& executionId, const QString& script, const QVariantList& arguments = {}, int timeout = 0);
+	/**
+	 * @param arguments Available to the script as arg1, arg2, ... NumericBuffer and lists of double, float, qint32 or
+	 * qint64 are passed without copying, as read-only numpy arrays or, without numpy, memoryviews.
+	 * Numeric data comes back the same way: "import embedpython; embedpython.set_result(array)" makes the
+	 * array available through PythonResult::getResultBuffer().
+	 * @param limits Only memoryBytes applies in-process: a quota on the script's Python allocations. Exceeding it raises
+	 * MemoryError in this execution only and fails it with ExecutionError::MemoryLimit. Requires enableMemoryQuotas().
+	 */
+	QFuture<PythonResult> runScriptAsync(const QString& executionId, const QString& script, const QVariantList& arguments = {}, int timeout = 0,
+		const ExecutionLimits& limits = {});
+
+	/**
+	 * @brief Installs the allocator hooks behind per-execution memory quotas. Call before the first PythonRunner is created.
+	 * Adds 16 bytes to every Python allocation; with the hooks installed, results report peakAllocatedBytes.
+	 * @return False if Python is already initialized or the build is free-threaded.
+	 */
+	static bool enableMemoryQuotas();
 
 	void cancel(); // Modify to cancel all running scripts if necessary
 	void cancel(const QString& executionId);
+
+	/**
+	 * @brief Caps the output kept in memory per execution and stream.
+	 * @param bytes Output beyond the cap is spilled to a temporary file referenced by the PythonResult. Use -1 for no cap.
+	 */
+	void setOutputMemoryLimit(qint64 bytes);
+
+	/**
+	 * @brief Sets the number of interpreters runScriptAsync() spreads executions over.
+	 * @param size Number of interpreter threads. Defaults to the number of cores.
+	 * @param ownGil On Python 3.12+, give every thread a sub-interpreter with its own GIL so scripts run in parallel.
+	 * Extension modules without sub-interpreter support cannot be imported there; pass false to share the main GIL instead.
+	 * Waits for queued executions of the previous pool to finish.
+	 */
+	void setInterpreterPoolSize(int size, bool ownGil = true);
+
+	/**
+	 * @brief Queue depth and queue/GIL wait times of the interpreter threads. Results carry their own queue stats.
+	 */
+	ExecutorStats executorStats() const;
+
+	/**
+	 * @brief True when running on a free-threaded (no-GIL) CPython build with the GIL actually disabled.
+	 * Pool threads then run scripts concurrently in the main interpreter and the ownGil setting has no effect.
+	 */
+	bool isFreeThreaded() const;
+
+	/**
+	 * @brief Limits every execution to a number of executed lines or opcodes instead of wall-clock time.
+	 * An execution that runs out gets embedpython.BudgetExceeded raised in it and fails with
+	 * ExecutionError::BudgetExceeded; results report the units used in ResourceUsage::executedUnits.
+	 * The budget is enforced through the thread's trace function, so scripts that install their own
+	 * tracer through sys.settrace() are no longer counted.
+	 * @param units Budget per execution. Use -1 to turn the budget off (the default).
+	 */
+	void setExecutionBudget(qint64 units, BudgetUnit unit = BudgetUnit::Lines);
+
+	/**
+	 * @brief Profiles a random fraction of executions with a sampling profiler; see PythonResult::getProfile().
+	 * @param sampleRate Fraction of executions to profile, 0 to turn profiling off (the default) and 1 for all.
+	 * @param interval Milliseconds between stack samples. Every sample briefly takes the script's GIL.
+	 */
+	void setProfiling(double sampleRate, int interval = 10);
+
+	/**
+	 * @brief Bounds the cache of compiled scripts, keyed by a hash of the source.
+	 * @param scripts Maximum number of cached scripts. Defaults to 256; use 0 to compile every time.
+	 */
+	void setCodeCacheCapacity(int scripts);
+	CodeCacheStats codeCacheStats() const;
+
+	/**
+	 * @brief Sets modules imported once per interpreter into the template every execution's globals are copied from.
+	 * @param modules Module names such as "json" or "os.path"; scripts see them as if they had run "import <name>".
+	 * Modules that fail to import are logged and left out.
+	 */
+	void setPreimportedModules(const QStringList& modules);
+
+	/**
+	 * @brief Opens a session whose namespace persists across runInSession() calls, so imports and loaded data
+	 * are set up once. Runs of one session execute one after another on the same interpreter.
+	 * @param idleTimeout Milliseconds without a run after which the session is closed. Use -1 to keep it open.
+	 * @param memoryLimit Bytes the session's runs may keep allocated. With enableMemoryQuotas() all runs are charged
+	 * to one quota, and an allocation beyond it raises MemoryError in the run. Without it the limit is checked after
+	 * each run against an estimate of the objects the namespace references, which misses memory held elsewhere.
+	 * Either way the run fails with ExecutionError::MemoryLimit and the session is closed. Use -1 for no limit.
+	 * @return False if a session with this ID is already open.
+	 */
+	bool openSession(const QString& sessionId, int idleTimeout = -1, qint64 memoryLimit = -1);
+
+	/**
+	 * @brief Runs a script in the namespace of an open session. Fails with ExecutionError::Rejected if there is none.
+	 */
+	QFuture<PythonResult> runInSession(const QString& sessionId, const QString& executionId, const QString& script, const QVariantList& arguments = {});
+
+	/**
+	 * @brief Closes a session and frees its namespace after the runs already queued for it.
+	 * @return False if no session with this ID was open.
+	 */
+	bool closeSession(const QString& sessionId);
+	bool hasSession(const QString& sessionId) const;
+
+signals:
+	/**
+	 * @brief Emitted when the runner closed a session on its own: idle timeout, memory limit or pool reset.
+	 */
+	void sessionClosed(const QString& sessionId, const QString& reason);
+
 private:
 	class Impl;
 	std::unique_ptr<Impl> impl; // Pimpl
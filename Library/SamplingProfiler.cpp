@@ -0,0 +1,105 @@
+#include "SamplingProfiler.h"
+#include <QStringList>
+#include <algorithm>
+
+SamplingProfiler::SamplingProfiler(int interval)
+	: target(PyThreadState_Get()), samplerState(nullptr), interval(qMax(1, interval)), stopping(false)
+{
+#ifndef Py_GIL_DISABLED
+	sampler = std::thread(&SamplingProfiler::run, this, PyThreadState_GetInterpreter(target));
+#endif
+}
+
+SamplingProfiler::~SamplingProfiler()
+{
+	if (sampler.joinable()) {
+		stop();
+	}
+}
+
+QString SamplingProfiler::stop()
+{
+	if (!sampler.joinable())
+		return QString();
+
+	{
+		std::lock_guard<std::mutex> locker(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+
+	// A sampler waiting for the GIL needs it once more to see that it has to stop
+	PyThreadState* current = PyEval_SaveThread();
+	sampler.join();
+	PyEval_RestoreThread(current);
+
+	if (samplerState) {
+		// Clearing needs the interpreter's GIL, which the profiled thread holds again
+		PyThreadState_Clear(samplerState);
+		PyThreadState_Delete(samplerState);
+		samplerState = nullptr;
+	}
+
+	QList<QPair<QString, int>> sorted;
+	sorted.reserve(stacks.size());
+	for (auto stack = stacks.cbegin(); stack != stacks.cend(); ++stack) {
+		sorted.append({ stack.key(), stack.value() });
+	}
+	std::sort(sorted.begin(), sorted.end(), [](const QPair<QString, int>& a, const QPair<QString, int>& b) { return a.second > b.second; });
+
+	QString collapsed;
+	for (const QPair<QString, int>& stack : sorted) {
+		collapsed += stack.first + ' ' + QString::number(stack.second) + '\n';
+	}
+	return collapsed;
+}
+
+void SamplingProfiler::run(PyInterpreterState* interpreter)
+{
+	// Created here so the thread state is bound to the thread that uses it
+	samplerState = PyThreadState_New(interpreter);
+	if (!samplerState)
+		return;
+
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> locker(mutex);
+			if (wake.wait_for(locker, interval, [this]() { return stopping; }))
+				return;
+		}
+
+		PyEval_RestoreThread(samplerState);
+		{
+			// The profiled thread sets stopping while it holds the GIL, so its frames are still valid here if not set
+			std::lock_guard<std::mutex> locker(mutex);
+			if (!stopping) {
+				sample();
+			}
+		}
+		PyEval_SaveThread();
+	}
+}
+
+void SamplingProfiler::sample()
+{
+	QStringList frames;
+	PyFrameObject* frame = PyThreadState_GetFrame(target);
+	while (frame) {
+		PyCodeObject* code = PyFrame_GetCode(frame);
+		frames.append(QString("%1 (%2:%3)")
+			.arg(QString::fromUtf8(PyUnicode_AsUTF8(code->co_name)))
+			.arg(QString::fromUtf8(PyUnicode_AsUTF8(code->co_filename)))
+			.arg(PyFrame_GetLineNumber(frame)));
+		Py_DECREF(code);
+
+		PyFrameObject* back = PyFrame_GetBack(frame);
+		Py_DECREF(frame);
+		frame = back;
+	}
+	PyErr_Clear();
+
+	if (!frames.isEmpty()) {
+		std::reverse(frames.begin(), frames.end()); // Collapsed stacks start at the root
+		++stacks[frames.join(';')];
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <Python.h>
+#include <QHash>
+#include <QString>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/**
+ * @brief Samples the Python stack of one executing thread from a background thread.
+ *
+ * The sampler wakes up every interval, takes the GIL of the profiled thread's interpreter through a thread
+ * state of its own, and records the stack the profiled thread is in. Each sample costs one GIL handover,
+ * so the overhead is set by the interval. Samples are aggregated into collapsed stacks as they are taken.
+ *
+ * Free-threaded builds are not supported: without a GIL the frames cannot be read while they change.
+ */
+class SamplingProfiler
+{
+public:
+	/**
+	 * @brief Starts sampling the calling thread. The caller holds the GIL.
+	 * @param interval Milliseconds between samples.
+	 */
+	explicit SamplingProfiler(int interval);
+	~SamplingProfiler();
+
+	SamplingProfiler(const SamplingProfiler&) = delete;
+	SamplingProfiler& operator=(const SamplingProfiler&) = delete;
+
+	/**
+	 * @brief Stops sampling and returns the collapsed stacks, most frequent first. The caller holds the GIL,
+	 * which is released briefly so the sampler can finish a sample it already started.
+	 */
+	QString stop();
+
+private:
+	PyThreadState* target; // The profiled thread
+	PyThreadState* samplerState; // The sampler's thread state in the same interpreter
+	std::chrono::milliseconds interval;
+	std::thread sampler;
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool stopping;
+	QHash<QString, int> stacks; // Collapsed stack -> samples, only touched by the sampler until it is joined
+
+	void run(PyInterpreterState* interpreter);
+	void sample();
+};
@@ -0,0 +1,101 @@
+#include "ScriptPayload.h"
+#include <QtEndian>
+#include <QDebug>
+
+QByteArray ScriptPayload::encode(const QString& script, const QVariantList& arguments)
+{
+	const QByteArray scriptBytes = script.toUtf8();
+
+	QByteArray payload;
+	payload.reserve(scriptBytes.size() + 64);
+	payload.append("EPY1", 4);
+	appendString(payload, 's', scriptBytes);
+	appendValue(payload, arguments);
+	return payload;
+}
+
+void ScriptPayload::appendCount(QByteArray& payload, quint32 count)
+{
+	const quint32 littleEndian = qToLittleEndian(count);
+	payload.append(reinterpret_cast<const char*>(&littleEndian), sizeof(littleEndian));
+}
+
+void ScriptPayload::appendString(QByteArray& payload, char tag, const QByteArray& bytes)
+{
+	payload.append(tag);
+	appendCount(payload, static_cast<quint32>(bytes.size()));
+	payload.append(bytes);
+}
+
+void ScriptPayload::appendValue(QByteArray& payload, const QVariant& value)
+{
+	if (!value.isValid() || value.isNull()) {
+		payload.append('N');
+		return;
+	}
+
+	switch (value.metaType().id()) {
+	case QMetaType::Bool:
+		payload.append(value.toBool() ? 'T' : 'F');
+		return;
+	case QMetaType::Int:
+	case QMetaType::UInt:
+	case QMetaType::Long:
+	case QMetaType::LongLong:
+	case QMetaType::Short:
+	case QMetaType::UShort: {
+		const qint64 littleEndian = qToLittleEndian<qint64>(value.toLongLong());
+		payload.append('i');
+		payload.append(reinterpret_cast<const char*>(&littleEndian), sizeof(littleEndian));
+		return;
+	}
+	case QMetaType::ULong:
+	case QMetaType::ULongLong: {
+		const quint64 littleEndian = qToLittleEndian<quint64>(value.toULongLong());
+		payload.append('u');
+		payload.append(reinterpret_cast<const char*>(&littleEndian), sizeof(littleEndian));
+		return;
+	}
+	case QMetaType::Float:
+	case QMetaType::Double: {
+		const double number = value.toDouble();
+		quint64 bits;
+		memcpy(&bits, &number, sizeof(bits));
+		bits = qToLittleEndian(bits);
+		payload.append('d');
+		payload.append(reinterpret_cast<const char*>(&bits), sizeof(bits));
+		return;
+	}
+	case QMetaType::QString:
+		appendString(payload, 's', value.toString().toUtf8());
+		return;
+	case QMetaType::QByteArray:
+		appendString(payload, 'b', value.toByteArray());
+		return;
+	case QMetaType::QStringList:
+	case QMetaType::QVariantList: {
+		const QVariantList list = value.toList();
+		payload.append('l');
+		appendCount(payload, static_cast<quint32>(list.size()));
+		for (const QVariant& item : list) {
+			appendValue(payload, item);
+		}
+		return;
+	}
+	case QMetaType::QVariantMap:
+	case QMetaType::QVariantHash: {
+		const QVariantMap map = value.toMap();
+		payload.append('m');
+		appendCount(payload, static_cast<quint32>(map.size()));
+		for (auto it = map.cbegin(); it != map.cend(); ++it) {
+			appendString(payload, 's', it.key().toUtf8());
+			appendValue(payload, it.value());
+		}
+		return;
+	}
+	default:
+		qWarning() << "Passing argument of type" << value.typeName() << "to Python as a string.";
+		appendString(payload, 's', value.toString().toUtf8());
+		return;
+	}
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include "global.h"
+#include <QByteArray>
+#include <QString>
+#include <QVariant>
+
+/**
+ * @brief Binary encoding of a script and its arguments, read by scripts/bootstrap.py from the child's stdin.
+ *
+ * The payload starts with the magic "EPY1", followed by the script and the argument list as tagged values.
+ * Lengths and counts are little-endian uint32, integers are little-endian int64/uint64 and floats IEEE doubles:
+ *
+ *   'N' None, 'T' True, 'F' False, 'i' int64, 'u' uint64, 'd' double,
+ *   's' UTF-8 str, 'b' bytes, 'l' list of values, 'm' dict of str keys to values
+ *
+ * Values of other types are sent as their QVariant::toString() representation.
+ */
+class LIBRARY_EXPORT ScriptPayload
+{
+public:
+	static QByteArray encode(const QString& script, const QVariantList& arguments);
+
+private:
+	static void appendValue(QByteArray& payload, const QVariant& value);
+	static void appendString(QByteArray& payload, char tag, const QByteArray& bytes);
+	static void appendCount(QByteArray& payload, quint32 count);
+};
@@ -0,0 +1,92 @@
+#include "TimerWheel.h"
+#include <QStringList>
+
+TimerWheel::TimerWheel(int tickInterval, int bucketCount, QObject* parent)
+	: QObject(parent), tickInterval(qMax(1, tickInterval)), currentTick(0), buckets(qMax(1, bucketCount))
+{
+	tickTimer.setInterval(this->tickInterval);
+	tickTimer.setTimerType(Qt::PreciseTimer);
+	connect(&tickTimer, &QTimer::timeout, this, &TimerWheel::onTick);
+}
+
+qint64 TimerWheel::elapsedTicks() const
+{
+	return clock.elapsed() / tickInterval;
+}
+
+void TimerWheel::schedule(const QString& key, int delay)
+{
+	cancel(key);
+
+	if (!tickTimer.isActive()) {
+		// The wheel restarts from tick zero whenever it wakes up from idle
+		clock.start();
+		currentTick = 0;
+		tickTimer.start();
+	}
+
+	// Round up so a deadline never fires early, and always land on a tick that is still to be processed
+	const qint64 ticks = qMax<qint64>(1, (qMax(0, delay) + tickInterval - 1) / tickInterval);
+	const qint64 dueTick = qMax(elapsedTicks(), currentTick) + ticks;
+	const int bucket = static_cast<int>(dueTick % buckets.size());
+
+	buckets[bucket].insert(key, dueTick);
+	bucketIndex.insert(key, bucket);
+}
+
+bool TimerWheel::cancel(const QString& key)
+{
+	auto it = bucketIndex.find(key);
+	if (it == bucketIndex.end())
+		return false;
+
+	buckets[it.value()].remove(key);
+	bucketIndex.erase(it);
+
+	if (bucketIndex.isEmpty()) {
+		tickTimer.stop();
+	}
+	return true;
+}
+
+bool TimerWheel::contains(const QString& key) const
+{
+	return bucketIndex.contains(key);
+}
+
+qsizetype TimerWheel::size() const
+{
+	return bucketIndex.size();
+}
+
+void TimerWheel::onTick()
+{
+	QStringList expiredKeys;
+
+	// A late tick catches up on every tick it missed
+	const qint64 now = elapsedTicks();
+	while (currentTick < now) {
+		++currentTick;
+
+		QHash<QString, qint64>& bucket = buckets[currentTick % buckets.size()];
+		for (auto it = bucket.begin(); it != bucket.end();) {
+			if (it.value() <= currentTick) {
+				expiredKeys.append(it.key());
+				bucketIndex.remove(it.key());
+				it = bucket.erase(it);
+			}
+			else {
+				++it; // Due on a later revolution
+			}
+		}
+	}
+
+	if (bucketIndex.isEmpty()) {
+		tickTimer.stop();
+	}
+
+	// Handlers may schedule or cancel, so they run after the wheel is consistent again
+	for (const QString& key : expiredKeys) {
+		emit expired(key);
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include "global.h"
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QVector>
+#include <QString>
+
+/**
+ * @brief Hashed timer wheel serving any number of deadlines from a single QTimer.
+ *
+ * Deadlines are hashed into buckets by expiry tick; a bucket holds the keys due on that tick or on a later
+ * revolution of the wheel. Scheduling and cancelling are constant-time, and a tick only touches the keys
+ * of one bucket. The tick source only runs while deadlines are pending. Expiry is accurate to one tick.
+ */
+class LIBRARY_EXPORT TimerWheel : public QObject
+{
+	Q_OBJECT
+
+public:
+	/**
+	 * @param tickInterval Resolution of the wheel in milliseconds.
+	 * @param bucketCount Number of buckets; deadlines further out than one revolution wait extra rounds.
+	 */
+	explicit TimerWheel(int tickInterval = 10, int bucketCount = 512, QObject* parent = nullptr);
+
+	/**
+	 * @brief Schedules key to expire after delay milliseconds, replacing a pending deadline for the same key.
+	 */
+	void schedule(const QString& key, int delay);
+
+	/**
+	 * @brief Removes the pending deadline of key.
+	 * @return True if a deadline was pending.
+	 */
+	bool cancel(const QString& key);
+
+	bool contains(const QString& key) const;
+	qsizetype size() const;
+
+signals:
+	void expired(const QString& key);
+
+private slots:
+	void onTick();
+
+private:
+	int tickInterval;
+	QTimer tickTimer;
+	QElapsedTimer clock;
+	qint64 currentTick; // Last tick that has been processed
+
+	QVector<QHash<QString, qint64>> buckets; // key -> tick the deadline falls due on
+	QHash<QString, int> bucketIndex; // key -> bucket, so cancel does not search
+
+	qint64 elapsedTicks() const;
+};
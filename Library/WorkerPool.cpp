@@ -2,6 +2,13 @@
 #include <QJsonArray>
 #include <QDebug>
 #include <QCryptographicHash>
+#include <QFile>
+#include <QUuid>
+
+#ifdef Q_OS_LINUX
+#include <signal.h>
+#include <sys/types.h>
+#endif
 
 QString generateHash() {
 	// Retrieve system-specific identifiers
@@ -20,9 +27,78 @@ QString generateHash() {
 	return hash.toHex();
 }
 
-WorkerPool::WorkerPool(const QString& workerPath, QObject* parent)
-	: QObject(parent), workerScriptPath(workerPath), token(generateHash()) {
-	prespawnWorkers(2); // Pre-spawn 2 workers
+WorkerPool::WorkerPool(const QString& pythonExecutable, const QProcessEnvironment& environment, QObject* parent)
+	: QObject(parent), pythonExecutablePath(pythonExecutable), processEnvironment(environment), token(generateHash()),
+	minWorkers(0), maxWorkers(0), shuttingDown(false), zygote(nullptr), workerServer(nullptr), pendingSpawns(0) {
+	QFile workerFile(":/scripts/worker.py");
+	if (workerFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
+		workerSource = QString::fromUtf8(workerFile.readAll());
+	}
+	else {
+		qCritical() << "Failed to load worker script from resources.";
+	}
+}
+
+WorkerPool::~WorkerPool() {
+	shuttingDown = true;
+
+	// Workers are children of the pool; detach them so their exit does not trigger a respawn.
+	for (QIODevice* worker : workers) {
+		disconnect(worker, nullptr, this, nullptr);
+		killWorker(worker);
+	}
+	stopZygote();
+
+	QJsonObject errorResult;
+	errorResult["success"] = false;
+	errorResult["error"] = "Worker pool was destroyed.";
+	for (auto it = activeTasks.begin(); it != activeTasks.end(); ++it) {
+		finishTask(it.value(), errorResult);
+	}
+	for (Task& task : taskQueue) {
+		finishTask(task, errorResult);
+	}
+}
+
+void WorkerPool::setPoolSize(int minimum, int maximum) {
+	{
+		QMutexLocker locker(&workerMutex);
+		minWorkers = qMax(0, minimum);
+		maxWorkers = qMax(minWorkers, maximum);
+
+		// Retire idle workers above the new upper bound
+		while (workers.size() > maxWorkers && !availableWorkers.isEmpty()) {
+			QIODevice* worker = availableWorkers.takeLast();
+			workers.removeOne(worker);
+			outputBuffers.remove(worker);
+			disconnect(worker, nullptr, this, nullptr);
+			killWorker(worker);
+			workerPids.remove(worker);
+			worker->deleteLater();
+		}
+	}
+
+	prespawnWorkers(minWorkers - workers.size() - pendingSpawns);
+}
+
+void WorkerPool::setZygoteModules(const QStringList& modules) {
+#ifdef Q_OS_LINUX
+	zygoteModules = modules;
+	if (!zygote) {
+		startZygote();
+	}
+#else
+	Q_UNUSED(modules);
+	qWarning() << "Zygote mode requires fork() and is not available on this platform.";
+#endif
+}
+
+bool WorkerPool::hasCapacity() const {
+	QMutexLocker taskLocker(&taskQueueMutex);
+	QMutexLocker workerLocker(&workerMutex);
+
+	// Idle and still-starting workers plus room to grow, minus what is already waiting
+	return maxWorkers - activeTasks.size() - taskQueue.size() > 0;
 }
 
 void WorkerPool::prespawnWorkers(int count) {
@@ -32,8 +108,33 @@ void WorkerPool::prespawnWorkers(int count) {
 }
 
 void WorkerPool::spawnWorker() {
+	if (zygote) {
+		// The zygote answers by forking a child that connects to workerServer
+		{
+			QMutexLocker locker(&workerMutex);
+			++pendingSpawns;
+		}
+		zygote->write("spawn\n");
+		return;
+	}
+
+	spawnProcessWorker();
+}
+
+void WorkerPool::spawnProcessWorker() {
 	QProcess* worker = new QProcess(this);
-	worker->setProgram(workerScriptPath);
+	worker->setProgram(pythonExecutablePath);
+	worker->setArguments({ "-u", "-c", workerSource, "--token", token });
+	worker->setProcessEnvironment(processEnvironment);
+	worker->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+
+	connect(worker, &QProcess::started, this, [this, worker]() {
+		{
+			QMutexLocker locker(&workerMutex);
+			availableWorkers.append(worker);
+		}
+		assignWorkerToTask();
+		});
 
 	connect(worker, &QProcess::readyReadStandardOutput, this, [this, worker]() {
 		handleWorkerOutput(worker);
@@ -44,95 +145,348 @@ void WorkerPool::spawnWorker() {
 			handleWorkerExit(worker);
 		});
 
-	worker->start();
-	if (worker->waitForStarted()) {
+	// finished() is not emitted when the interpreter could not be started at all
+	connect(worker, &QProcess::errorOccurred, this, [this, worker](QProcess::ProcessError error) {
+		if (error == QProcess::FailedToStart) {
+			qWarning() << "Failed to start worker process:" << worker->errorString();
+			handleWorkerExit(worker);
+		}
+		});
+
+	{
 		QMutexLocker locker(&workerMutex);
-		availableWorkers.append(worker);
+		workers.append(worker);
 	}
-	else {
-		qWarning() << "Failed to start worker process.";
-		worker->deleteLater();
+
+	worker->start();
+}
+
+void WorkerPool::startZygote() {
+	workerServer = new QLocalServer(this);
+	workerServer->setSocketOptions(QLocalServer::UserAccessOption);
+	const QString serverName = QString("EmbedPythonWorkers-%1").arg(QUuid::createUuid().toString(QUuid::WithoutBraces));
+	if (!workerServer->listen(serverName)) {
+		qWarning() << "Failed to listen for forked workers:" << workerServer->errorString();
+		delete workerServer;
+		workerServer = nullptr;
+		return;
 	}
+	connect(workerServer, &QLocalServer::newConnection, this, &WorkerPool::handleWorkerConnection);
+
+	zygote = new QProcess(this);
+	zygote->setProgram(pythonExecutablePath);
+	zygote->setArguments({ "-u", "-c", workerSource, "--token", token,
+		"--zygote", "--server", workerServer->fullServerName(), "--preload", zygoteModules.join(',') });
+	zygote->setProcessEnvironment(processEnvironment);
+	zygote->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+
+	connect(zygote, &QProcess::readyReadStandardOutput, this, &WorkerPool::handleZygoteOutput);
+
+	auto onZygoteGone = [this]() {
+		if (shuttingDown) {
+			return;
+		}
+		qWarning() << "Zygote process exited, falling back to regular worker spawning.";
+
+		int lostSpawns = 0;
+		{
+			QMutexLocker locker(&workerMutex);
+			lostSpawns = pendingSpawns;
+			pendingSpawns = 0;
+		}
+		stopZygote();
+		prespawnWorkers(lostSpawns);
+		};
+	connect(zygote, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this, onZygoteGone);
+	connect(zygote, &QProcess::errorOccurred, this, [onZygoteGone](QProcess::ProcessError error) {
+		if (error == QProcess::FailedToStart) {
+			onZygoteGone();
+		}
+		});
+
+	// Fork requests queue up in the pipe until the preload imports are done
+	zygote->start();
 }
 
-void WorkerPool::assignWorkerToTask() {
-	QMutexLocker taskLocker(&taskQueueMutex);
-	QMutexLocker workerLocker(&workerMutex);
+void WorkerPool::stopZygote() {
+	if (zygote) {
+		disconnect(zygote, nullptr, this, nullptr);
+		zygote->kill();
+		zygote->deleteLater();
+		zygote = nullptr;
+	}
+	if (workerServer) {
+		workerServer->close();
+		workerServer->deleteLater();
+		workerServer = nullptr;
+	}
+}
 
-	if (taskQueue.isEmpty() || availableWorkers.isEmpty()) {
+void WorkerPool::killWorker(QIODevice* worker) {
+	if (auto* process = qobject_cast<QProcess*>(worker)) {
+		process->kill();
 		return;
 	}
 
-	QProcess* worker = availableWorkers.takeFirst();
-	Task task = taskQueue.dequeue();
-	activeTasks[worker] = task;
+#ifdef Q_OS_LINUX
+	// Forked workers are not our children; the socket disconnect reports their exit
+	const qint64 pid = workerPids.value(worker, 0);
+	if (pid > 0) {
+		::kill(static_cast<pid_t>(pid), SIGKILL);
+	}
+#endif
+}
+
+void WorkerPool::assignWorkerToTask() {
+	bool needsWorker = false;
+	{
+		QMutexLocker taskLocker(&taskQueueMutex);
+		QMutexLocker workerLocker(&workerMutex);
+
+		while (!taskQueue.isEmpty() && !availableWorkers.isEmpty()) {
+			QIODevice* worker = availableWorkers.takeFirst();
+			Task task = taskQueue.dequeue();
 
-	QJsonObject inputObj;
-	inputObj["script"] = task.script;
+			QJsonObject inputObj;
+			inputObj["script"] = task.script;
 
-	QJsonArray argsArray;
-	for (const auto& arg : task.arguments) {
-		argsArray.append(QJsonValue::fromVariant(arg));
+			QJsonArray argsArray;
+			for (const auto& arg : task.arguments) {
+				argsArray.append(QJsonValue::fromVariant(arg));
+			}
+			inputObj["arguments"] = argsArray;
+			inputObj["token"] = token; // Add the token
+			inputObj["command"] = "execute";
+			inputObj["stream"] = task.stream;
+			inputObj["retainOutput"] = task.retainOutput;
+
+			activeTasks[worker] = task;
+
+			QByteArray inputData = QJsonDocument(inputObj).toJson(QJsonDocument::Compact) + "\n";
+			worker->write(inputData);
+		}
+
+		// Grow the pool if the queued work exceeds the workers that are still starting up
+		const qsizetype startingWorkers = workers.size() + pendingSpawns - availableWorkers.size() - activeTasks.size();
+		needsWorker = taskQueue.size() > startingWorkers && workers.size() + pendingSpawns < maxWorkers;
 	}
-	inputObj["arguments"] = argsArray;
-	inputObj["token"] = token; // Add the token
-	inputObj["command"] = "execute";
 
-	QByteArray inputData = QJsonDocument(inputObj).toJson(QJsonDocument::Compact) + "\n";
-	worker->write(inputData);
-	worker->closeWriteChannel();
+	if (needsWorker) {
+		spawnWorker();
+	}
 }
 
-QFuture<QJsonObject> WorkerPool::executeScript(const QString& executionId, const QString& script, const QVariantList& arguments) {
+QFuture<QJsonObject> WorkerPool::executeScript(const QString& executionId, const QString& script, const QVariantList& arguments,
+	bool stream, bool retainOutput) {
 	QFutureInterface<QJsonObject> futureInterface;
+	futureInterface.reportStarted();
 	QFuture<QJsonObject> future = futureInterface.future();
 
 	{
 		QMutexLocker locker(&taskQueueMutex);
-		taskQueue.enqueue({ executionId, script, arguments, futureInterface });
+		Task task{ executionId, script, arguments, futureInterface, QElapsedTimer(), QString() };
+		task.stream = stream;
+		task.retainOutput = retainOutput;
+		task.elapsedTimer.start();
+		taskQueue.enqueue(task);
 	}
 
 	assignWorkerToTask();
 	return future;
 }
 
-void WorkerPool::handleWorkerOutput(QProcess* worker) {
-	QByteArray outputData = worker->readAllStandardOutput();
-	QJsonDocument outputDoc = QJsonDocument::fromJson(outputData);
+bool WorkerPool::cancel(const QString& executionId, const QString& reason, int errorCode) {
+	{
+		QMutexLocker locker(&taskQueueMutex);
+		for (qsizetype i = 0; i < taskQueue.size(); ++i) {
+			if (taskQueue[i].executionId == executionId) {
+				Task task = taskQueue.takeAt(i);
+				locker.unlock();
 
-	if (!outputDoc.isObject()) {
-		qWarning() << "Invalid output from worker:" << outputData;
-		return;
+				QJsonObject errorResult;
+				errorResult["success"] = false;
+				errorResult["error"] = reason;
+				errorResult["errorCode"] = errorCode;
+				finishTask(task, errorResult);
+				return true;
+			}
+		}
+
+		for (auto it = activeTasks.begin(); it != activeTasks.end(); ++it) {
+			if (it.value().executionId == executionId) {
+				// The result is reported from handleWorkerExit once the worker is gone
+				it.value().cancelReason = reason;
+				it.value().cancelErrorCode = errorCode;
+				killWorker(it.key());
+				return true;
+			}
+		}
 	}
 
-	QJsonObject result = outputDoc.object();
+	return false;
+}
 
-	if (activeTasks.contains(worker)) {
-		Task task = activeTasks.take(worker);
-		task.futureInterface.reportFinished(&result);
+void WorkerPool::handleWorkerConnection() {
+	while (workerServer && workerServer->hasPendingConnections()) {
+		QLocalSocket* socket = workerServer->nextPendingConnection();
+
+		// The first line on the socket is the worker's hello, see registerForkedWorker()
+		connect(socket, &QLocalSocket::readyRead, this, [this, socket]() {
+			handleWorkerOutput(socket);
+			});
+		connect(socket, &QLocalSocket::disconnected, this, [this, socket]() {
+			handleWorkerExit(socket);
+			});
 	}
+}
 
+bool WorkerPool::registerForkedWorker(QIODevice* worker, const QJsonObject& hello) {
+	if (hello["command"].toString() != "hello" || hello["token"].toString() != token) {
+		qWarning() << "Rejected worker connection with an invalid handshake.";
+		return false;
+	}
+
+	QMutexLocker locker(&workerMutex);
+	workerPids.insert(worker, hello["pid"].toInteger());
+	workers.append(worker);
+	availableWorkers.append(worker);
+	pendingSpawns = qMax(0, pendingSpawns - 1);
+	return true;
+}
+
+void WorkerPool::handleWorkerOutput(QIODevice* worker) {
+	QList<QByteArray> lines;
 	{
-		QMutexLocker locker(&workerMutex);
-		availableWorkers.append(worker);
+		QByteArray& buffer = outputBuffers[worker];
+		buffer.append(worker->readAll());
+
+		qsizetype newline;
+		while ((newline = buffer.indexOf('\n')) != -1) {
+			lines.append(buffer.left(newline));
+			buffer.remove(0, newline + 1);
+		}
+	}
+
+	for (const QByteArray& line : lines) {
+		QJsonDocument outputDoc = QJsonDocument::fromJson(line);
+
+		if (!outputDoc.isObject()) {
+			qWarning() << "Invalid output from worker:" << line;
+			continue;
+		}
+
+		if (!workers.contains(worker)) {
+			if (!registerForkedWorker(worker, outputDoc.object())) {
+				outputBuffers.remove(worker);
+				disconnect(worker, nullptr, this, nullptr);
+				qobject_cast<QLocalSocket*>(worker)->abort();
+				worker->deleteLater();
+				return;
+			}
+			continue;
+		}
+
+		if (!activeTasks.contains(worker)) {
+			continue;
+		}
+
+		// A streaming task sends its output ahead of the final reply
+		const QJsonObject reply = outputDoc.object();
+		if (reply["command"].toString() == "output") {
+			emit outputReceived(activeTasks[worker].executionId, reply["stream"].toString() == "stderr", reply["chunk"].toString());
+			continue;
+		}
+
+		Task task = activeTasks.take(worker);
+		finishTask(task, reply);
+
+		{
+			QMutexLocker locker(&workerMutex);
+			availableWorkers.append(worker);
+		}
 	}
 
 	assignWorkerToTask();
 }
 
-void WorkerPool::handleWorkerExit(QProcess* worker) {
+void WorkerPool::handleWorkerExit(QIODevice* worker) {
+	auto* process = qobject_cast<QProcess*>(worker);
+	const bool failedToStart = process && process->error() == QProcess::FailedToStart;
+	bool respawn = false;
 	{
 		QMutexLocker locker(&workerMutex);
+		if (!workers.removeOne(worker)) {
+			// errorOccurred and finished may both report the same process;
+			// a socket that never completed its handshake was never registered
+			if (!process) {
+				outputBuffers.remove(worker);
+				worker->deleteLater();
+			}
+			return;
+		}
 		availableWorkers.removeOne(worker);
+		outputBuffers.remove(worker);
+		workerPids.remove(worker);
+		respawn = !shuttingDown && !failedToStart && workers.size() + pendingSpawns < minWorkers;
 	}
 
 	if (activeTasks.contains(worker)) {
 		Task task = activeTasks.take(worker);
 		QJsonObject errorResult;
 		errorResult["success"] = false;
-		errorResult["error"] = "Worker process terminated unexpectedly.";
-		task.futureInterface.reportFinished(&errorResult);
+		errorResult["error"] = task.cancelReason.isEmpty() ? QString("Worker process terminated unexpectedly.") : task.cancelReason;
+		errorResult["errorCode"] = task.cancelErrorCode;
+		finishTask(task, errorResult);
 	}
 
 	worker->deleteLater();
+
+	if (failedToStart) {
+		// Do not retry here, a missing interpreter would otherwise spawn in a loop
+		if (!workers.isEmpty()) {
+			return;
+		}
+
+		// Nothing will ever pick up the queued work; fail it instead of leaving the futures pending
+		QMutexLocker locker(&taskQueueMutex);
+		QQueue<Task> pending;
+		pending.swap(taskQueue);
+		locker.unlock();
+
+		QJsonObject errorResult;
+		errorResult["success"] = false;
+		errorResult["error"] = "Failed to start worker process.";
+		for (Task& task : pending) {
+			finishTask(task, errorResult);
+		}
+		return;
+	}
+
+	if (respawn) {
+		spawnWorker();
+	}
+	assignWorkerToTask();
+}
+
+void WorkerPool::handleZygoteOutput() {
+	while (zygote && zygote->canReadLine()) {
+		const QByteArray line = zygote->readLine().trimmed();
+		const QJsonObject reply = QJsonDocument::fromJson(line).object();
+
+		// A failed fork will never connect back, so spawn that worker the regular way
+		if (reply["command"].toString() == "spawnFailed") {
+			qWarning() << "Zygote failed to fork a worker:" << reply["error"].toString();
+			{
+				QMutexLocker locker(&workerMutex);
+				pendingSpawns = qMax(0, pendingSpawns - 1);
+			}
+			spawnProcessWorker();
+		}
+	}
+}
+
+void WorkerPool::finishTask(Task& task, QJsonObject result) {
+	result["executionTime"] = task.elapsedTimer.elapsed();
+	task.futureInterface.reportResult(result);
+	task.futureInterface.reportFinished();
 }
@@ -3,25 +3,76 @@
 
 #include <QObject>
 #include <QProcess>
+#include <QProcessEnvironment>
+#include <QLocalServer>
+#include <QLocalSocket>
 #include <QJsonObject>
 #include <QJsonDocument>
 #include <QVariant>
 #include <QFuture>
 #include <QFutureInterface>
+#include <QElapsedTimer>
 #include <QQueue>
 #include <QMutex>
 #include <QMap>
+#include <QHash>
 
 
-//the problem with worker pools are that they are limited would need to start always one in addition
-//second problem is the handling with pip install packages! 
+/**
+ * @brief Keeps long-lived Python interpreters warm and dispatches scripts to idle ones.
+ *
+ * Each worker runs scripts/worker.py and speaks one JSON object per line.
+ * The pool keeps at least minWorkers interpreters alive and grows on demand up to maxWorkers.
+ * A worker that is cancelled or times out is killed and replaced, since its state is unknown.
+ *
+ * On Linux the pool can run in zygote mode: a template interpreter imports the preload modules once,
+ * freezes the GC and forks workers on request. Forked workers share those pages copy-on-write and
+ * connect back to the pool over a local socket instead of stdin/stdout.
+ */
 class WorkerPool : public QObject {
 	Q_OBJECT
 
 public:
-	explicit WorkerPool(const QString& workerPath, QObject* parent = nullptr);
+	explicit WorkerPool(const QString& pythonExecutable, const QProcessEnvironment& environment, QObject* parent = nullptr);
+	~WorkerPool();
 
-	QFuture<QJsonObject> executeScript(const QString& executionId, const QString& script, const QVariantList& arguments);
+	/**
+	 * @brief Sets the pool bounds and pre-spawns workers up to minWorkers.
+	 * @param minWorkers Number of interpreters kept warm at all times.
+	 * @param maxWorkers Upper bound on concurrently running interpreters.
+	 */
+	void setPoolSize(int minWorkers, int maxWorkers);
+
+	/**
+	 * @brief Enables zygote mode. Call before setPoolSize so pre-spawned workers are forked too.
+	 * @param modules Modules the template interpreter imports before it starts forking.
+	 * Ignored on platforms without fork().
+	 */
+	void setZygoteModules(const QStringList& modules);
+
+	/**
+	 * @brief Returns true if a new task would be served by an idle worker or by growing the pool.
+	 */
+	bool hasCapacity() const;
+
+	/**
+	 * @brief Queues a script for the next idle worker.
+	 * @param stream Forward the script's output through outputReceived() while it runs.
+	 * @param retainOutput Also return the streamed output in the result. Without streaming it is always returned.
+	 */
+	QFuture<QJsonObject> executeScript(const QString& executionId, const QString& script, const QVariantList& arguments,
+		bool stream = false, bool retainOutput = true);
+
+	/**
+	 * @brief Aborts a queued or running task. A running task's worker is killed and replaced.
+	 * @param reason Error message reported in the task's result.
+	 * @param errorCode Reported as "errorCode" in the task's result.
+	 * @return True if a task with the given executionId was found.
+	 */
+	bool cancel(const QString& executionId, const QString& reason, int errorCode = 0);
+
+signals:
+	void outputReceived(const QString& executionId, bool errorOutput, const QString& chunk);
 
 private:
 	struct Task {
@@ -30,21 +81,49 @@ private:
 		QVariantList arguments;
 
 		QFutureInterface<QJsonObject> futureInterface;
+		QElapsedTimer elapsedTimer;
+		QString cancelReason;
+		int cancelErrorCode = 0;
+		bool stream = false;
+		bool retainOutput = true;
 	};
 
-	QString workerScriptPath;
+	QString pythonExecutablePath;
+	QProcessEnvironment processEnvironment;
+	QString workerSource;
 	QString token; // Unique token
-	QList<QProcess*> availableWorkers;
+	int minWorkers;
+	int maxWorkers;
+	bool shuttingDown;
+
+	// Workers are QProcess instances, or QLocalSocket connections of forked workers in zygote mode
+	QList<QIODevice*> workers;
+	QList<QIODevice*> availableWorkers;
+	QHash<QIODevice*, QByteArray> outputBuffers;
+	QHash<QIODevice*, qint64> workerPids;
 	QQueue<Task> taskQueue;
-	QMap<QProcess*, Task> activeTasks;
-	QMutex taskQueueMutex;
-	QMutex workerMutex;
+	QMap<QIODevice*, Task> activeTasks;
+	mutable QMutex taskQueueMutex;
+	mutable QMutex workerMutex;
+
+	QStringList zygoteModules;
+	QProcess* zygote;
+	QLocalServer* workerServer;
+	int pendingSpawns; // Fork requests sent to the zygote that have not connected back yet
 
 	void prespawnWorkers(int count);
 	void spawnWorker();
+	void spawnProcessWorker();
+	void startZygote();
+	void stopZygote();
+	void killWorker(QIODevice* worker);
 	void assignWorkerToTask();
-	void handleWorkerOutput(QProcess* worker);
-	void handleWorkerExit(QProcess* worker);
+	void handleWorkerConnection();
+	bool registerForkedWorker(QIODevice* worker, const QJsonObject& hello);
+	void handleWorkerOutput(QIODevice* worker);
+	void handleWorkerExit(QIODevice* worker);
+	void handleZygoteOutput();
+	void finishTask(Task& task, QJsonObject result);
 };
 
 #endif // WORKERPOOL_H
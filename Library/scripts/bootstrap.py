@@ -0,0 +1,117 @@
+import os
+import sys
+import json
+import atexit
+import struct
+import types
+import traceback
+
+# Exception that ended the script, reported so the runner can tell a hit resource limit from a script error
+uncaught = {}
+
+
+def read_exact(stream, size):
+    data = stream.read(size)
+    if len(data) != size:
+        raise EOFError("Truncated script payload.")
+    return data
+
+
+def read_count(stream):
+    return struct.unpack('<I', read_exact(stream, 4))[0]
+
+
+def read_value(stream):
+    tag = read_exact(stream, 1)
+    if tag == b'N':
+        return None
+    if tag == b'T':
+        return True
+    if tag == b'F':
+        return False
+    if tag == b'i':
+        return struct.unpack('<q', read_exact(stream, 8))[0]
+    if tag == b'u':
+        return struct.unpack('<Q', read_exact(stream, 8))[0]
+    if tag == b'd':
+        return struct.unpack('<d', read_exact(stream, 8))[0]
+    if tag == b's':
+        return read_exact(stream, read_count(stream)).decode('utf-8')
+    if tag == b'b':
+        return read_exact(stream, read_count(stream))
+    if tag == b'l':
+        return [read_value(stream) for _ in range(read_count(stream))]
+    if tag == b'm':
+        result = {}
+        for _ in range(read_count(stream)):
+            key = read_value(stream)
+            result[key] = read_value(stream)
+        return result
+    raise ValueError("Unknown tag %r in script payload." % tag)
+
+
+def report_resource_usage(fd):
+    """
+    Writes the rusage of this process and of the children it waited for to the runner's accounting pipe.
+    """
+    try:
+        import resource
+        own = resource.getrusage(resource.RUSAGE_SELF)
+        children = resource.getrusage(resource.RUSAGE_CHILDREN)
+        # ru_maxrss is in kilobytes, except on macOS
+        rss_unit = 1 if sys.platform == 'darwin' else 1024
+        usage = {
+            "userCpuTime": int((own.ru_utime + children.ru_utime) * 1000000),
+            "systemCpuTime": int((own.ru_stime + children.ru_stime) * 1000000),
+            "peakRss": max(own.ru_maxrss, children.ru_maxrss) * rss_unit,
+            "voluntaryContextSwitches": own.ru_nvcsw + children.ru_nvcsw,
+            "involuntaryContextSwitches": own.ru_nivcsw + children.ru_nivcsw,
+            "blockInputOperations": own.ru_inblock + children.ru_inblock,
+            "blockOutputOperations": own.ru_oublock + children.ru_oublock,
+        }
+        usage.update(uncaught)
+        os.write(fd, json.dumps(usage).encode('utf-8'))
+    except Exception:
+        pass
+    finally:
+        os.close(fd)
+
+
+def main():
+    """
+    Reads the script and its arguments from stdin and runs the script as __main__, the way -c would.
+    """
+    usage_fd = os.environ.pop('EMBEDPYTHON_RUSAGE_FD', None)
+    if usage_fd is not None:
+        # Keep the pipe out of processes the script starts, and report after non-daemon threads have finished
+        os.set_inheritable(int(usage_fd), False)
+        atexit.register(report_resource_usage, int(usage_fd))
+
+    stream = sys.stdin.buffer
+    if read_exact(stream, 4) != b'EPY1':
+        raise ValueError("Invalid script payload.")
+    script = read_value(stream)
+    arguments = read_value(stream)
+
+    module = types.ModuleType('__main__')
+    module.__builtins__ = __builtins__
+    for i, arg in enumerate(arguments):
+        setattr(module, 'arg%d' % (i + 1), arg)
+    sys.modules['__main__'] = module
+    sys.argv = ['-c']
+
+    try:
+        exec(compile(script, '<string>', 'exec'), module.__dict__)
+    except SystemExit:
+        raise
+    except BaseException:
+        # Leave the bootstrap frame out, so the traceback reads as if the script had been run directly
+        etype, value, tb = sys.exc_info()
+        uncaught["exception"] = etype.__name__
+        if isinstance(value, OSError) and value.errno is not None:
+            uncaught["errno"] = value.errno
+        traceback.print_exception(etype, value, tb.tb_next)
+        sys.exit(1)
+
+
+main()
@@ -1,7 +1,12 @@
 import sys
+import os
+import gc
 import json
+import signal
+import socket
 import traceback
 import argparse
+import importlib
 from io import StringIO
 import threading
 import queue
@@ -10,10 +15,91 @@ import queue
 def parse_arguments():
     parser = argparse.ArgumentParser(description="Python Worker Script")
     parser.add_argument('--token', required=True, help='Authentication token for executing scripts.')
+    parser.add_argument('--zygote', action='store_true', help='Preload modules and fork workers on request.')
+    parser.add_argument('--server', default='', help='Local socket forked workers connect back to.')
+    parser.add_argument('--preload', default='', help='Comma-separated modules imported before forking.')
     return parser.parse_args()
 
 
+def resource_snapshot():
+    try:
+        import resource
+        return resource.getrusage(resource.RUSAGE_SELF)
+    except ImportError:
+        return None
+
+
+def resource_delta(before, after):
+    """
+    Usage of one execution: CPU and counters are differences, peak RSS is the worker's high-water mark.
+    """
+    if before is None or after is None:
+        return {}
+    rss_unit = 1 if sys.platform == 'darwin' else 1024
+    return {
+        "userCpuTime": int((after.ru_utime - before.ru_utime) * 1000000),
+        "systemCpuTime": int((after.ru_stime - before.ru_stime) * 1000000),
+        "peakRss": after.ru_maxrss * rss_unit,
+        "voluntaryContextSwitches": after.ru_nvcsw - before.ru_nvcsw,
+        "involuntaryContextSwitches": after.ru_nivcsw - before.ru_nivcsw,
+        "blockInputOperations": after.ru_inblock - before.ru_inblock,
+        "blockOutputOperations": after.ru_oublock - before.ru_oublock,
+    }
+
+
+class StreamingOutput:
+    """
+    Forwards a script's writes to the pool as "output" messages while it runs, one line at a time.
+    """
+    def __init__(self, stream, channel, lock, retained):
+        self.stream = stream
+        self.channel = channel
+        self.lock = lock
+        self.retained = retained
+        self.pending = []
+        self.pending_size = 0
+
+    def write(self, text):
+        if self.retained is not None:
+            self.retained.write(text)
+        self.pending.append(text)
+        self.pending_size += len(text)
+        if '\n' in text or self.pending_size >= 8192:
+            self.flush()
+        return len(text)
+
+    def flush(self):
+        if not self.pending:
+            return
+        chunk = ''.join(self.pending)
+        self.pending = []
+        self.pending_size = 0
+        with self.lock:
+            self.channel.write(json.dumps({"command": "output", "stream": self.stream, "chunk": chunk}) + "\n")
+            self.channel.flush()
+
+    def isatty(self):
+        return False
+
+    def getvalue(self):
+        return self.retained.getvalue() if self.retained is not None else ""
+
+
 def execute_script(token, SECRET_TOKEN, data, result_queue):
+    usage_before = resource_snapshot()
+    old_stdout = sys.stdout
+    old_stderr = sys.stderr
+    if data.get("stream", False):
+        # Only keep a copy for the final reply if the pool asked for one
+        lock = threading.Lock()
+        retain = data.get("retainOutput", True)
+        output = StreamingOutput("stdout", old_stdout, lock, StringIO() if retain else None)
+        error_output = StreamingOutput("stderr", old_stdout, lock, StringIO() if retain else None)
+    else:
+        output = StringIO()
+        error_output = StringIO()
+    success = True
+
     try:
         # Verify secret token
         received_token = data.get("token", "")
@@ -24,42 +110,35 @@ def execute_script(token, SECRET_TOKEN, data, result_queue):
         arguments = data.get("arguments", [])
 
         # Redirect stdout and stderr
-        old_stdout = sys.stdout
-        old_stderr = sys.stderr
-        sys.stdout = StringIO()
-        sys.stderr = StringIO()
+        sys.stdout = output
+        sys.stderr = error_output
 
-        # Execute the script
-        exec_globals = {}
+        # Execute the script in a fresh namespace so runs do not leak into each other
+        exec_globals = {"__name__": "__main__", "__builtins__": __builtins__}
         for i, arg in enumerate(arguments):
             exec_globals[f'arg{i+1}'] = arg
-        exec(script, exec_globals)
-
-        # Capture output
-        output = sys.stdout.getvalue()
-        error_output = sys.stderr.getvalue()
-
-        # Restore stdout and stderr
+        exec(compile(script, "<string>", "exec"), exec_globals)
+    except SystemExit as e:
+        # sys.exit() must not take the worker down with it
+        success = e.code is None or e.code == 0
+    except BaseException:
+        # Capture traceback
+        success = False
+        error_output.write(traceback.format_exc())
+    finally:
+        # Restore stdout and stderr, the worker keeps serving requests afterwards
         sys.stdout = old_stdout
         sys.stderr = old_stderr
-
-        # Prepare result
-        result = {
-            "success": True,
-            "output": output,
-            "error": error_output
-        }
-    except Exception as e:
-        # Capture traceback
-        error_output = traceback.format_exc()
-        result = {
-            "success": False,
-            "output": "",
-            "error": error_output
-        }
+        output.flush()
+        error_output.flush()
 
     # Put the result in the queue
-    result_queue.put(result)
+    result_queue.put({
+        "success": success,
+        "output": output.getvalue(),
+        "error": error_output.getvalue(),
+        "resourceUsage": resource_delta(usage_before, resource_snapshot())
+    })
 
 
 def control_listener(command_queue, shutdown_event):
@@ -89,10 +168,7 @@ def control_listener(command_queue, shutdown_event):
             print(json.dumps({"success": False, "error": str(e)}))
 
 
-def main():
-    args = parse_arguments()
-    SECRET_TOKEN = args.token  # The token provided via command line
-
+def serve(SECRET_TOKEN):
     # Queues for inter-thread communication
     result_queue = queue.Queue()
     command_queue = queue.Queue()
@@ -141,5 +217,82 @@ def main():
         control_thread.join()
 
 
+def run_forked_worker(args):
+    """
+    Runs in a child forked by the zygote: talks to the pool over its local socket.
+    """
+    connection = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    connection.connect(args.server)
+
+    # Keep stray fd-level writes away from the zygote's control pipe
+    devnull = os.open(os.devnull, os.O_RDWR)
+    os.dup2(devnull, 0)
+    os.dup2(devnull, 1)
+    os.close(devnull)
+
+    sys.stdin = connection.makefile('r', encoding='utf-8')
+    sys.stdout = connection.makefile('w', encoding='utf-8')
+
+    # Children must not share the template's random state
+    if 'random' in sys.modules:
+        sys.modules['random'].seed()
+
+    print(json.dumps({"command": "hello", "pid": os.getpid(), "token": args.token}))
+    sys.stdout.flush()
+
+    serve(args.token)
+
+
+def run_zygote(args):
+    """
+    Imports the preload modules once, freezes the GC and forks a worker for every "spawn" line on stdin.
+    """
+    for module in filter(None, args.preload.split(',')):
+        try:
+            importlib.import_module(module)
+        except Exception:
+            traceback.print_exc()
+
+    # Move everything imported so far into the permanent generation so collections in the
+    # children do not touch (and thereby copy) the shared pages
+    gc.collect()
+    if hasattr(gc, 'freeze'):
+        gc.freeze()
+
+    # Forked workers are reaped automatically; the pool notices their exit through the socket
+    signal.signal(signal.SIGCHLD, signal.SIG_IGN)
+
+    for line in sys.stdin:
+        if line.strip() != "spawn":
+            continue
+
+        try:
+            pid = os.fork()
+        except OSError as e:
+            print(json.dumps({"command": "spawnFailed", "error": str(e)}))
+            sys.stdout.flush()
+            continue
+
+        if pid == 0:
+            exit_code = 0
+            try:
+                # Scripts that wait on their own subprocesses need the default disposition back
+                signal.signal(signal.SIGCHLD, signal.SIG_DFL)
+                run_forked_worker(args)
+            except BaseException:
+                traceback.print_exc()
+                exit_code = 1
+            finally:
+                os._exit(exit_code)
+
+
+def main():
+    args = parse_arguments()
+    if args.zygote:
+        run_zygote(args)
+    else:
+        serve(args.token)  # The token provided via command line
+
+
 if __name__ == "__main__":
     main()
@@ -0,0 +1,243 @@
+// DataConverterTest.cpp
+#include "../pch.h"
+#include "Library/DataConverter.h"
+#include <QDateTime>
+#include <QTimeZone>
+#include <QPoint>
+#include <limits>
+
+class DataConverterTest : public ::testing::Test {
+protected:
+	static void SetUpTestSuite() {
+		if (!Py_IsInitialized()) {
+			Py_InitializeEx(0);
+			PyEval_SaveThread(); // Leave the GIL to PyGILState_Ensure() like any other caller
+		}
+	}
+
+	void SetUp() override {
+		gil = PyGILState_Ensure();
+	}
+
+	void TearDown() override {
+		PyGILState_Release(gil);
+	}
+
+	// Converts to Python and back
+	static QVariant roundTrip(const QVariant& value) {
+		PyObject* obj = DataConverter::QVariantToPyObject(value);
+		EXPECT_NE(obj, nullptr);
+		const QVariant result = DataConverter::PyObjectToQVariant(obj);
+		Py_XDECREF(obj);
+		return result;
+	}
+
+	PyGILState_STATE gil;
+};
+
+TEST_F(DataConverterTest, SixtyFourBitIntegersAreNotTruncated) {
+	// Arrange
+	const qlonglong large = std::numeric_limits<qlonglong>::max();
+	const qlonglong small = std::numeric_limits<qlonglong>::min();
+	const qulonglong unsignedLarge = std::numeric_limits<qulonglong>::max();
+
+	// Act & Assert
+	EXPECT_EQ(roundTrip(large).toLongLong(), large);
+	EXPECT_EQ(roundTrip(small).toLongLong(), small);
+	EXPECT_EQ(roundTrip(unsignedLarge).toULongLong(), unsignedLarge);
+}
+
+TEST_F(DataConverterTest, ScalarsRoundTrip) {
+	// Act & Assert
+	EXPECT_EQ(roundTrip(true).metaType().id(), QMetaType::Bool);
+	EXPECT_TRUE(roundTrip(true).toBool());
+	EXPECT_FALSE(roundTrip(false).toBool());
+	EXPECT_DOUBLE_EQ(roundTrip(2.5).toDouble(), 2.5);
+	EXPECT_EQ(roundTrip(QString::fromUtf8("grüße \xF0\x9F\x90\x8D")).toString(), QString::fromUtf8("grüße \xF0\x9F\x90\x8D"));
+	EXPECT_FALSE(roundTrip(QVariant()).isValid());
+}
+
+TEST_F(DataConverterTest, BytesKeepEmbeddedNulls) {
+	// Arrange
+	const QByteArray bytes("a\0b\xff", 4);
+
+	// Act
+	PyObject* obj = DataConverter::QVariantToPyObject(bytes);
+
+	// Assert
+	ASSERT_NE(obj, nullptr);
+	EXPECT_TRUE(PyBytes_Check(obj));
+	EXPECT_EQ(DataConverter::PyObjectToQVariant(obj).toByteArray(), bytes);
+	Py_DECREF(obj);
+}
+
+TEST_F(DataConverterTest, DateTimesKeepTheirOffset) {
+	// Arrange
+	const QDateTime utc(QDate(2024, 2, 29), QTime(13, 45, 30, 250), QTimeZone::UTC);
+	const QDateTime offset(QDate(1999, 12, 31), QTime(23, 59, 59), QTimeZone::fromSecondsAheadOfUtc(3600));
+	const QDateTime local(QDate(2020, 6, 1), QTime(8, 0));
+
+	// Act & Assert
+	EXPECT_EQ(roundTrip(utc).toDateTime(), utc);
+	EXPECT_EQ(roundTrip(offset).toDateTime().offsetFromUtc(), 3600);
+	EXPECT_EQ(roundTrip(offset).toDateTime(), offset);
+	EXPECT_EQ(roundTrip(local).toDateTime(), local);
+	EXPECT_EQ(roundTrip(QDate(2001, 9, 9)).toDate(), QDate(2001, 9, 9));
+	EXPECT_EQ(roundTrip(QTime(1, 2, 3, 4)).toTime(), QTime(1, 2, 3, 4));
+}
+
+TEST_F(DataConverterTest, NestedContainersRoundTrip) {
+	// Arrange
+	QVariantMap inner;
+	inner["values"] = QVariantList{ 1, 2.5, "three", QVariantList{ true } };
+	inner["names"] = QStringList{ "a", "b" };
+	QVariantHash hash;
+	hash["id"] = Q_INT64_C(1) << 40;
+	QVariantMap outer;
+	outer["inner"] = inner;
+	outer["hash"] = hash;
+	outer["empty"] = QVariantMap();
+
+	// Act
+	const QVariantMap result = roundTrip(outer).toMap();
+
+	// Assert
+	const QVariantMap resultInner = result["inner"].toMap();
+	const QVariantList values = resultInner["values"].toList();
+	ASSERT_EQ(values.size(), 4);
+	EXPECT_EQ(values[0].toLongLong(), 1);
+	EXPECT_DOUBLE_EQ(values[1].toDouble(), 2.5);
+	EXPECT_EQ(values[2].toString(), "three");
+	EXPECT_TRUE(values[3].toList().value(0).toBool());
+	EXPECT_EQ(resultInner["names"].toStringList(), (QStringList{ "a", "b" }));
+	EXPECT_EQ(result["hash"].toMap()["id"].toLongLong(), Q_INT64_C(1) << 40);
+	EXPECT_TRUE(result["empty"].toMap().isEmpty());
+}
+
+TEST_F(DataConverterTest, PythonOnlyTypesConvertToTheClosestQVariant) {
+	// Arrange
+	PyObject* globals = PyDict_New();
+	PyObject* value = PyRun_String("((1, 2), {3: 'x'}, bytearray(b'yz'), 2 ** 70)", Py_eval_input, globals, globals);
+	ASSERT_NE(value, nullptr);
+
+	// Act
+	const QVariantList result = DataConverter::PyObjectToQVariant(value).toList();
+
+	// Assert
+	ASSERT_EQ(result.size(), 4);
+	EXPECT_EQ(result[0].toList().size(), 2);
+	EXPECT_EQ(result[1].toMap()["3"].toString(), "x");
+	EXPECT_EQ(result[2].toByteArray(), QByteArray("yz"));
+	EXPECT_DOUBLE_EQ(result[3].toDouble(), 1180591620717411303424.0);
+	Py_DECREF(value);
+	Py_DECREF(globals);
+}
+
+TEST_F(DataConverterTest, NumericListsAreSharedNotCopied) {
+	// Arrange
+	QList<double> values(1000000, 0.5);
+	const QByteArray bytes(4096, 'x');
+
+	// Act
+	PyObject* valuesObj = DataConverter::QVariantToPyObject(QVariant::fromValue(values));
+	PyObject* bytesObj = DataConverter::QVariantToPyObject(QVariant::fromValue(NumericBuffer(bytes)));
+
+	// Assert
+	ASSERT_NE(valuesObj, nullptr);
+	ASSERT_NE(bytesObj, nullptr);
+	Py_buffer view;
+	ASSERT_EQ(PyObject_GetBuffer(valuesObj, &view, PyBUF_RECORDS_RO), 0);
+	EXPECT_EQ(view.buf, values.constData());
+	EXPECT_EQ(view.len, values.size() * qsizetype(sizeof(double)));
+	EXPECT_STREQ(view.format, "d");
+	EXPECT_TRUE(view.readonly);
+	PyBuffer_Release(&view);
+	EXPECT_EQ(PyObject_GetBuffer(valuesObj, &view, PyBUF_WRITABLE), -1);
+	PyErr_Clear();
+
+	ASSERT_EQ(PyObject_GetBuffer(bytesObj, &view, PyBUF_SIMPLE), 0);
+	EXPECT_EQ(view.buf, bytes.constData());
+	PyBuffer_Release(&view);
+
+	// Writing to the original detaches it instead of changing what Python sees
+	values[0] = 2.0;
+	ASSERT_EQ(PyObject_GetBuffer(valuesObj, &view, PyBUF_RECORDS_RO), 0);
+	EXPECT_EQ(static_cast<const double*>(view.buf)[0], 0.5);
+	PyBuffer_Release(&view);
+
+	Py_DECREF(valuesObj);
+	Py_DECREF(bytesObj);
+}
+
+TEST_F(DataConverterTest, BufferArgumentKeepsItsShape) {
+	// Arrange
+	const QByteArray storage(6 * sizeof(double), '\0');
+	const NumericBuffer matrix(storage, 'd', { 2, 3 });
+
+	// Act
+	PyObject* obj = DataConverter::QVariantToPyObject(QVariant::fromValue(matrix));
+
+	// Assert
+	ASSERT_NE(obj, nullptr);
+	Py_buffer view;
+	ASSERT_EQ(PyObject_GetBuffer(obj, &view, PyBUF_RECORDS_RO), 0);
+	ASSERT_EQ(view.ndim, 2);
+	EXPECT_EQ(view.shape[0], 2);
+	EXPECT_EQ(view.shape[1], 3);
+	EXPECT_EQ(view.strides[0], 3 * qsizetype(sizeof(double)));
+	EXPECT_EQ(view.strides[1], qsizetype(sizeof(double)));
+	EXPECT_EQ(view.buf, storage.constData());
+	PyBuffer_Release(&view);
+	Py_DECREF(obj);
+}
+
+TEST_F(DataConverterTest, BufferResultsKeepTypeAndShape) {
+	// Arrange
+	PyObject* globals = PyDict_New();
+	PyObject* values = PyRun_String("__import__('array').array('q', [1, -2, 2 ** 40])", Py_eval_input, globals, globals);
+	PyObject* matrix = PyRun_String("memoryview(bytes(range(6))).cast('B', (2, 3))", Py_eval_input, globals, globals);
+	PyObject* unsigned16 = PyRun_String("__import__('array').array('H', [1])", Py_eval_input, globals, globals);
+	PyObject* signed8 = PyRun_String("__import__('array').array('b', [-1])", Py_eval_input, globals, globals);
+	ASSERT_NE(values, nullptr);
+	ASSERT_NE(signed8, nullptr);
+	ASSERT_NE(matrix, nullptr);
+	ASSERT_NE(unsigned16, nullptr);
+
+	// Act
+	const std::optional<NumericBuffer> valuesBuffer = DataConverter::PyObjectToNumericBuffer(values);
+	const std::optional<NumericBuffer> matrixBuffer = DataConverter::PyObjectToNumericBuffer(matrix);
+	const std::optional<NumericBuffer> unsupported = DataConverter::PyObjectToNumericBuffer(unsigned16);
+
+	// Assert
+	ASSERT_TRUE(valuesBuffer.has_value());
+	ASSERT_NE(valuesBuffer->data<qint64>(), nullptr);
+	EXPECT_EQ(valuesBuffer->count(), 3);
+	EXPECT_EQ(valuesBuffer->data<qint64>()[2], Q_INT64_C(1) << 40);
+	ASSERT_TRUE(matrixBuffer.has_value());
+	EXPECT_EQ(matrixBuffer->shape(), (QList<qsizetype>{ 2, 3 }));
+	EXPECT_EQ(matrixBuffer->toByteArray(), QByteArray("\x00\x01\x02\x03\x04\x05", 6));
+	EXPECT_FALSE(unsupported.has_value());
+	EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_TypeError));
+	PyErr_Clear();
+	EXPECT_FALSE(DataConverter::PyObjectToNumericBuffer(signed8).has_value());
+	PyErr_Clear();
+
+	Py_DECREF(signed8);
+	Py_DECREF(unsigned16);
+	Py_DECREF(matrix);
+	Py_DECREF(values);
+	Py_DECREF(globals);
+}
+
+TEST_F(DataConverterTest, UnsupportedTypeRaisesTypeError) {
+	// Arrange
+	const QVariant unsupported = QVariant::fromValue(QPoint(1, 2));
+
+	// Act
+	PyObject* obj = DataConverter::QVariantToPyObject(unsupported);
+
+	// Assert
+	EXPECT_EQ(obj, nullptr);
+	EXPECT_TRUE(PyErr_ExceptionMatches(PyExc_TypeError));
+	PyErr_Clear();
+}
@@ -6,6 +6,12 @@
 #include <gtest/gtest.h>
 #include <QSignalSpy>
 #include <QFutureWatcher>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#ifdef Q_OS_UNIX
+#include <signal.h>
+#endif
 
 class PythonRunnerTest : public ::testing::Test {
 protected:
@@ -101,6 +107,163 @@ TEST_F(PythonRunnerTest, AsynchronousExecutionWithCallback) {
 	EXPECT_EQ(result.getOutput().trimmed(), "25");
 }
 
+TEST_F(PythonRunnerTest, ArgumentsArePassedThroughStdin) {
+	// Arrange
+	QString script = "print(arg1 + 1, arg2, arg3, arg4['key'], arg5)";
+	QVariantList arguments = { 41, QString("text"), QVariantList{ true, QVariant() }, QVariantMap{ { "key", 1.5 } }, QByteArray("raw") };
+	QSignalSpy spy(runner.get(), &PythonRunner::scriptFinished);
+
+	// Act
+	QFuture<PythonResult> future = runner->runScriptAsync("argumentsExecutionId", script, arguments);
+	ASSERT_TRUE(spy.wait(3000));
+	PythonResult result = future.result();
+
+	// Assert
+	EXPECT_TRUE(result.isSuccess());
+	EXPECT_EQ(result.getOutput().trimmed(), "42 text [True, None] 1.5 b'raw'");
+}
+
+TEST_F(PythonRunnerTest, ScriptLargerThanCommandLine) {
+	// Arrange: well beyond ARG_MAX and the Windows command line limit
+	QString script = QString("x = 1\n").repeated(1000000) + "print(x)";
+	QSignalSpy spy(runner.get(), &PythonRunner::scriptFinished);
+
+	// Act
+	QFuture<PythonResult> future = runner->runScriptAsync("largeScriptExecutionId", script);
+	ASSERT_TRUE(spy.wait(10000));
+	PythonResult result = future.result();
+
+	// Assert
+	EXPECT_TRUE(result.isSuccess());
+	EXPECT_EQ(result.getOutput().trimmed(), "1");
+}
+
+#ifdef Q_OS_UNIX
+TEST_F(PythonRunnerTest, ResourceUsageIsReported) {
+	// Arrange: burn some CPU and allocate ~50 MB
+	QString script = "data = bytearray(50 * 1024 * 1024)\ntotal = sum(range(5000000))";
+	QSignalSpy spy(runner.get(), &PythonRunner::scriptFinished);
+
+	// Act
+	QFuture<PythonResult> future = runner->runScriptAsync("usageExecutionId", script);
+	ASSERT_TRUE(spy.wait(5000));
+	PythonResult result = future.result();
+
+	// Assert
+	ResourceUsage usage = result.getResourceUsage();
+	ASSERT_TRUE(usage.available);
+	EXPECT_GT(usage.userCpuTime, 0);
+	EXPECT_GE(usage.peakRss, 50 * 1024 * 1024);
+	EXPECT_TRUE(result.toJson().contains("resourceUsage"));
+}
+#endif
+
+#ifdef Q_OS_UNIX
+TEST_F(PythonRunnerTest, MemoryLimitIsReported) {
+	// Arrange
+	ExecutionLimits limits;
+	limits.memoryBytes = 256 * 1024 * 1024;
+	QString script = "data = bytearray(1024 * 1024 * 1024)";
+	QSignalSpy spy(runner.get(), &PythonRunner::scriptFinished);
+
+	// Act
+	QFuture<PythonResult> future = runner->runScriptAsync("memoryLimitExecutionId", script, {}, 10000, 0, limits);
+	ASSERT_TRUE(spy.wait(5000));
+	PythonResult result = future.result();
+
+	// Assert
+	EXPECT_FALSE(result.isSuccess());
+	EXPECT_EQ(result.getErrorCode(), static_cast<int>(ExecutionError::MemoryLimit));
+}
+
+TEST_F(PythonRunnerTest, CpuLimitIsDistinctFromTimeout) {
+	// Arrange
+	ExecutionLimits limits;
+	limits.cpuSeconds = 1;
+	QString script = "while True:\n    pass";
+	QSignalSpy spy(runner.get(), &PythonRunner::scriptFinished);
+
+	// Act
+	QFuture<PythonResult> future = runner->runScriptAsync("cpuLimitExecutionId", script, {}, 10000, 0, limits);
+	ASSERT_TRUE(spy.wait(5000));
+	PythonResult result = future.result();
+
+	// Assert
+	EXPECT_FALSE(result.isSuccess());
+	EXPECT_EQ(result.getErrorCode(), static_cast<int>(ExecutionError::CpuLimit));
+}
+#endif
+
+#ifdef Q_OS_UNIX
+TEST_F(PythonRunnerTest, CancelAsyncStopsProcessGroup) {
+	// Arrange: a script whose subprocess would outlive a plain kill of the interpreter
+	runner->setStreamingEnabled(true);
+	runner->setTerminationGracePeriod(500);
+	QString script = "import subprocess, sys, time\n"
+		"child = subprocess.Popen([sys.executable, '-c', 'import time; time.sleep(60)'])\n"
+		"print(child.pid, flush=True)\n"
+		"time.sleep(60)";
+	QSignalSpy chunkSpy(runner.get(), &PythonRunner::outputReceived);
+
+	QFuture<PythonResult> future = runner->runScriptAsync("groupExecutionId", script);
+	ASSERT_TRUE(chunkSpy.wait(5000));
+	const pid_t childPid = chunkSpy.first().at(1).toString().trimmed().toInt();
+	ASSERT_GT(childPid, 0);
+
+	// Act: returns without waiting for the group
+	QElapsedTimer blocked;
+	blocked.start();
+	QFuture<bool> terminated = runner->cancelAsync("groupExecutionId");
+	EXPECT_LT(blocked.elapsed(), 100);
+	ASSERT_TRUE(future.isFinished());
+	EXPECT_EQ(future.result().getErrorCode(), static_cast<int>(ExecutionError::Cancelled));
+
+	QElapsedTimer waited;
+	waited.start();
+	while (!terminated.isFinished() && waited.elapsed() < 5000) {
+		QCoreApplication::processEvents(QEventLoop::AllEvents, 50);
+	}
+
+	// Assert
+	ASSERT_TRUE(terminated.isFinished());
+	EXPECT_TRUE(terminated.result());
+	EXPECT_EQ(::kill(childPid, 0), -1);
+}
+#endif
+
+static QStringList capturedWarnings;
+
+TEST_F(PythonRunnerTest, CancelAsyncResolvesWithinGracePeriod) {
+	// Arrange: the interpreter exits on SIGTERM by default
+	runner->setStreamingEnabled(true);
+	runner->setTerminationGracePeriod(5000);
+	QSignalSpy chunkSpy(runner.get(), &PythonRunner::outputReceived);
+	QFuture<PythonResult> future = runner->runScriptAsync("politeExecutionId", "import time\nprint('ready', flush=True)\ntime.sleep(60)");
+	ASSERT_TRUE(chunkSpy.wait(5000));
+
+	capturedWarnings.clear();
+	const QtMessageHandler previousHandler = qInstallMessageHandler([](QtMsgType type, const QMessageLogContext&, const QString& message) {
+		if (type == QtWarningMsg) {
+			capturedWarnings.append(message);
+		}
+		});
+
+	// Act
+	QElapsedTimer waited;
+	waited.start();
+	QFuture<bool> terminated = runner->cancelAsync("politeExecutionId");
+	while (!terminated.isFinished() && waited.elapsed() < 10000) {
+		QCoreApplication::processEvents(QEventLoop::AllEvents, 50);
+	}
+	qInstallMessageHandler(previousHandler);
+
+	// Assert: reaped as soon as the group exited, without escalating
+	ASSERT_TRUE(terminated.isFinished());
+	EXPECT_TRUE(terminated.result());
+	EXPECT_LT(waited.elapsed(), 2000);
+	EXPECT_TRUE(capturedWarnings.filter("outlived the grace period").isEmpty());
+}
+
 TEST_F(PythonRunnerTest, ExecutionTimeMeasurement) {
 	// Arrange
 	QString script = "import time\ntime.sleep(2)\nprint('Done')";
@@ -121,6 +284,201 @@ TEST_F(PythonRunnerTest, ExecutionTimeMeasurement) {
 	EXPECT_TRUE(result.isSuccess());
 	EXPECT_GE(result.getExecutionTime(), 2000);
 }
+
+TEST_F(PythonRunnerTest, ConcurrentTimeouts) {
+	// Arrange
+	runner->setMaxConcurrency(20);
+	QString script = "import time\ntime.sleep(10)";
+	QList<QFuture<PythonResult>> futures;
+
+	// Act
+	for (int i = 0; i < 20; ++i) {
+		futures.append(runner->runScriptAsync(QString("timeoutExecutionId%1").arg(i), script, {}, 500));
+	}
+
+	QElapsedTimer waited;
+	waited.start();
+	auto allFinished = [&futures]() {
+		return std::all_of(futures.begin(), futures.end(), [](const QFuture<PythonResult>& f) { return f.isFinished(); });
+	};
+	while (!allFinished() && waited.elapsed() < 5000) {
+		QCoreApplication::processEvents(QEventLoop::AllEvents, 50);
+	}
+
+	// Assert: every deadline fires, none of them early
+	ASSERT_TRUE(allFinished());
+	for (const QFuture<PythonResult>& future : futures) {
+		PythonResult result = future.result();
+		EXPECT_FALSE(result.isSuccess());
+		EXPECT_EQ(result.getErrorOutput(), "Execution timed out.");
+		EXPECT_GE(result.getExecutionTime(), 500);
+	}
+}
+
+TEST_F(PythonRunnerTest, AdmissionControlQueuesAndRejects) {
+	// Arrange: one slot and one queue place
+	runner->setMaxConcurrency(1, 1);
+	QString script = "import time\ntime.sleep(0.5)\nprint('done')";
+
+	// Act
+	QFuture<PythonResult> running = runner->runScriptAsync("admittedExecutionId", script);
+	QFuture<PythonResult> queued = runner->runScriptAsync("queuedExecutionId", script);
+	QFuture<PythonResult> rejected = runner->runScriptAsync("rejectedExecutionId", script);
+
+	// Assert: the overflow is turned away without waiting
+	ASSERT_TRUE(rejected.isFinished());
+	EXPECT_EQ(rejected.result().getErrorCode(), static_cast<int>(ExecutionError::Rejected));
+
+	QElapsedTimer waited;
+	waited.start();
+	while (!queued.isFinished() && waited.elapsed() < 5000) {
+		QCoreApplication::processEvents(QEventLoop::AllEvents, 50);
+	}
+
+	ASSERT_TRUE(queued.isFinished());
+	EXPECT_TRUE(running.result().isSuccess());
+	EXPECT_EQ(running.result().getQueueWaitTime(), 0);
+
+	PythonResult result = queued.result();
+	EXPECT_TRUE(result.isSuccess());
+	EXPECT_EQ(result.getQueueDepth(), 0);
+	EXPECT_GE(result.getQueueWaitTime(), 500);
+}
+
+TEST_F(PythonRunnerTest, PooledExecutionSuccess) {
+	// Arrange
+	runner->setPoolSize(1, 2);
+	QString script = "leaked = 1\nprint(arg1 + arg2)";
+
+	// Act
+	QFuture<PythonResult> future = runner->runScriptAsync("pooledExecutionId", script, { 10, 20 });
+	QFuture<PythonResult> second = runner->runScriptAsync("pooledExecutionId2", "print('leaked' in globals())");
+
+	// Pooled results arrive through the event loop, so keep it running instead of blocking on the futures
+	QElapsedTimer waited;
+	waited.start();
+	while (!(future.isFinished() && second.isFinished()) && waited.elapsed() < 10000) {
+		QCoreApplication::processEvents(QEventLoop::AllEvents, 50);
+	}
+
+	// Assert
+	ASSERT_TRUE(future.isFinished());
+	ASSERT_TRUE(second.isFinished());
+	PythonResult result = future.result();
+	EXPECT_TRUE(result.isSuccess()) << result.getErrorOutput().toStdString();
+	EXPECT_EQ(result.getOutput().trimmed(), "30");
+
+	// Every pooled run starts from a fresh namespace
+	PythonResult isolated = second.result();
+	EXPECT_TRUE(isolated.isSuccess());
+	EXPECT_EQ(isolated.getOutput().trimmed(), "False");
+}
+#ifdef Q_OS_LINUX
+TEST_F(PythonRunnerTest, ZygoteForksPreloadedWorkers) {
+	// Arrange: decimal is not imported by the worker itself, only by the zygote's preload
+	runner->setPoolSize(1, 2, { "decimal" });
+	QString script = "import os, sys\nprint('decimal' in sys.modules, os.getppid())";
+
+	// Act
+	QFuture<PythonResult> first = runner->runScriptAsync("zygoteExecutionId", script);
+	QFuture<PythonResult> second = runner->runScriptAsync("zygoteExecutionId2", script);
+
+	QElapsedTimer waited;
+	waited.start();
+	while (!(first.isFinished() && second.isFinished()) && waited.elapsed() < 10000) {
+		QCoreApplication::processEvents(QEventLoop::AllEvents, 50);
+	}
+
+	// Assert: both workers inherited the preloaded module from a parent other than this process
+	ASSERT_TRUE(first.isFinished());
+	ASSERT_TRUE(second.isFinished());
+	for (const QFuture<PythonResult>& future : { first, second }) {
+		PythonResult result = future.result();
+		ASSERT_TRUE(result.isSuccess()) << result.getErrorOutput().toStdString();
+		const QStringList fields = result.getOutput().trimmed().split(' ');
+		ASSERT_EQ(fields.size(), 2);
+		EXPECT_EQ(fields[0], "True");
+		EXPECT_NE(fields[1].toLongLong(), QCoreApplication::applicationPid());
+	}
+}
+#endif
+
+TEST_F(PythonRunnerTest, StreamingDeliversChunksBeforeCompletion) {
+	// Arrange
+	runner->setStreamingEnabled(true, false);
+	QString script = "import time\nprint('first')\ntime.sleep(1)\nprint('second')";
+	QSignalSpy chunkSpy(runner.get(), &PythonRunner::outputReceived);
+	QSignalSpy finishedSpy(runner.get(), &PythonRunner::scriptFinished);
+
+	// Act
+	QFuture<PythonResult> future = runner->runScriptAsync("streamingExecutionId", script);
+
+	// Assert: the first line arrives while the script is still sleeping
+	ASSERT_TRUE(chunkSpy.wait(3000));
+	EXPECT_FALSE(future.isFinished());
+	EXPECT_EQ(chunkSpy.first().at(1).toString().trimmed(), "first");
+
+	ASSERT_TRUE(finishedSpy.wait(3000));
+	PythonResult result = future.result();
+	EXPECT_TRUE(result.isSuccess());
+	EXPECT_TRUE(result.getOutput().isEmpty()); // Streamed output is not retained
+}
+
+TEST_F(PythonRunnerTest, PooledStreamingDeliversChunksBeforeCompletion) {
+	// Arrange
+	runner->setPoolSize(1, 1);
+	runner->setStreamingEnabled(true, false);
+	QString script = "import sys, time\nprint('first')\nprint('oops', file=sys.stderr)\ntime.sleep(1)\nprint('second')";
+	QSignalSpy chunkSpy(runner.get(), &PythonRunner::outputReceived);
+	QSignalSpy errorSpy(runner.get(), &PythonRunner::errorOutputReceived);
+
+	// Act
+	QFuture<PythonResult> future = runner->runScriptAsync("pooledStreamingExecutionId", script);
+
+	// Assert: the first line arrives from the worker while the script is still sleeping
+	ASSERT_TRUE(chunkSpy.wait(5000));
+	EXPECT_FALSE(future.isFinished());
+	EXPECT_EQ(chunkSpy.first().at(0).toString(), "pooledStreamingExecutionId");
+	EXPECT_EQ(chunkSpy.first().at(1).toString().trimmed(), "first");
+
+	QElapsedTimer waited;
+	waited.start();
+	while (!future.isFinished() && waited.elapsed() < 5000) {
+		QCoreApplication::processEvents(QEventLoop::AllEvents, 50);
+	}
+
+	ASSERT_TRUE(future.isFinished());
+	PythonResult result = future.result();
+	EXPECT_TRUE(result.isSuccess());
+	EXPECT_EQ(chunkSpy.last().at(1).toString().trimmed(), "second");
+	ASSERT_FALSE(errorSpy.isEmpty());
+	EXPECT_EQ(errorSpy.first().at(1).toString().trimmed(), "oops");
+	EXPECT_TRUE(result.getOutput().isEmpty()); // Streamed output is not retained
+	EXPECT_TRUE(result.getErrorOutput().isEmpty());
+}
+
+TEST_F(PythonRunnerTest, LargeOutputSpillsToFile) {
+	// Arrange
+	runner->setOutputMemoryLimit(1024);
+	QString script = "print('x' * 100000)";
+	QSignalSpy spy(runner.get(), &PythonRunner::scriptFinished);
+
+	// Act
+	QFuture<PythonResult> future = runner->runScriptAsync("spillExecutionId", script);
+	ASSERT_TRUE(spy.wait(3000));
+	PythonResult result = future.result();
+
+	// Assert: only the preview stays in memory, the full output is in the file
+	EXPECT_TRUE(result.isSuccess());
+	EXPECT_TRUE(result.isOutputTruncated());
+	EXPECT_EQ(result.getOutput().size(), 1024);
+	EXPECT_GT(result.getOutputSize(), 100000);
+
+	QFile file(result.getOutputFilePath());
+	ASSERT_TRUE(file.open(QIODevice::ReadOnly));
+	EXPECT_EQ(file.size(), result.getOutputSize());
+}
+
 // 
 // TEST_F(PythonRunnerTest, CheckSyntaxSuccess) {
 // 	// Arrange
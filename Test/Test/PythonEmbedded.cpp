@@ -0,0 +1,441 @@
+// PythonEmbeddedTest.cpp
+#include "../pch.h"
+#include <Python.h>
+#include "Library/PythonRunner_embedded.h"
+#include "Library/PythonResult.h"
+#include <gtest/gtest.h>
+#include <QFutureWatcher>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QSignalSpy>
+#include <QCoreApplication>
+
+// Quotas need their allocator hooks before Python is initialized, i.e. before the first PythonRunner exists
+static const bool memoryQuotasEnabled = PythonRunner::enableMemoryQuotas();
+
+class PythonEmbeddedTest : public ::testing::Test {
+protected:
+	void SetUp() override {
+		runner = std::make_shared<PythonRunner>(nullptr);
+	}
+
+	std::shared_ptr<PythonRunner> runner;
+};
+
+TEST_F(PythonEmbeddedTest, RunScriptAsyncSuccess) {
+	// Arrange
+	QString script = "print(arg1 + arg2)";
+
+	// Act
+	QFuture<PythonResult> future = runner->runScriptAsync("embeddedExecutionId", script, { 10, 20 });
+	future.waitForFinished();
+	PythonResult result = future.result();
+
+	// Assert
+	EXPECT_TRUE(result.isSuccess());
+	EXPECT_EQ(result.getOutput().trimmed(), "30");
+}
+
+TEST_F(PythonEmbeddedTest, SubInterpretersRunInParallel) {
+	// Arrange
+	runner->setInterpreterPoolSize(4);
+	QString script = "total = 0\nfor i in range(3000000):\n    total += i\nprint(total)";
+
+	QElapsedTimer single;
+	single.start();
+	runner->runScriptAsync("warmupExecutionId", script).waitForFinished();
+	const qint64 singleTime = single.elapsed();
+
+	// Act
+	QElapsedTimer parallel;
+	parallel.start();
+	QList<QFuture<PythonResult>> futures;
+	for (int i = 0; i < 4; ++i) {
+		futures.append(runner->runScriptAsync(QString("parallelExecutionId%1").arg(i), script));
+	}
+	for (QFuture<PythonResult>& future : futures) {
+		future.waitForFinished();
+		EXPECT_TRUE(future.result().isSuccess());
+	}
+
+	// Assert: with one GIL four runs would take four times as long
+#if PY_VERSION_HEX >= 0x030C0000
+	EXPECT_LT(parallel.elapsed(), singleTime * 3);
+#else
+	Q_UNUSED(singleTime);
+#endif
+}
+
+TEST_F(PythonEmbeddedTest, ConcurrentArgumentsAndOutputStaySeparate) {
+	// Arrange
+	runner->setInterpreterPoolSize(4);
+	QString script = "import time\nfor _ in range(20):\n    print(arg1)\n    time.sleep(0.001)";
+
+	// Act
+	QList<QFuture<PythonResult>> futures;
+	for (int i = 0; i < 8; ++i) {
+		futures.append(runner->runScriptAsync(QString("separateExecutionId%1").arg(i), script, { i }));
+	}
+
+	// Assert
+	for (int i = 0; i < futures.size(); ++i) {
+		futures[i].waitForFinished();
+		PythonResult result = futures[i].result();
+		EXPECT_TRUE(result.isSuccess());
+		const QStringList lines = result.getOutput().split('\n', Qt::SkipEmptyParts);
+		EXPECT_EQ(lines.size(), 20);
+		for (const QString& line : lines) {
+			EXPECT_EQ(line.trimmed(), QString::number(i));
+		}
+	}
+}
+
+TEST_F(PythonEmbeddedTest, FreeThreadedBuildRunsSharedInterpreterInParallel) {
+	// Arrange: without a GIL, threads of the shared interpreter run CPU-bound scripts side by side
+	if (!runner->isFreeThreaded() || QThread::idealThreadCount() < 4) {
+		GTEST_SKIP() << "Needs a free-threaded Python build and at least four cores";
+	}
+	QString script = "total = 0\nfor i in range(2000000):\n    total += i * i\nprint(total)";
+	QMap<int, qint64> timings;
+
+	// Act
+	for (int threads : { 1, 4 }) {
+		runner->setInterpreterPoolSize(threads, false);
+		runner->runScriptAsync("scalingWarmup", script).waitForFinished();
+
+		QElapsedTimer timer;
+		timer.start();
+		QList<QFuture<PythonResult>> futures;
+		for (int i = 0; i < threads; ++i) {
+			futures.append(runner->runScriptAsync(QString("scalingExecutionId%1").arg(i), script));
+		}
+		for (QFuture<PythonResult>& future : futures) {
+			future.waitForFinished();
+			EXPECT_TRUE(future.result().isSuccess());
+		}
+		timings[threads] = timer.elapsed();
+	}
+
+	// Assert: with the GIL four scripts would take about four times as long as one
+	EXPECT_LT(timings[4], timings[1] * 3);
+}
+
+TEST_F(PythonEmbeddedTest, GlobalsDoNotLeakBetweenRuns) {
+	// Arrange
+	runner->runScriptAsync("definingExecutionId", "leaked = 1", { 42 }).waitForFinished();
+
+	// Act
+	PythonResult result = runner->runScriptAsync("checkingExecutionId", "print('leaked' in globals(), 'arg1' in globals())").result();
+
+	// Assert
+	EXPECT_TRUE(result.isSuccess());
+	EXPECT_EQ(result.getOutput().trimmed(), "False False");
+}
+
+TEST_F(PythonEmbeddedTest, PreimportedModulesAreAvailable) {
+	// Arrange
+	runner->setPreimportedModules({ "json", "os.path" });
+
+	// Act
+	PythonResult result = runner->runScriptAsync("preimportExecutionId", "print(json.dumps([os.path.basename('/a/b')]))").result();
+
+	// Assert
+	EXPECT_TRUE(result.isSuccess());
+	EXPECT_EQ(result.getOutput().trimmed(), "[\"b\"]");
+}
+
+TEST_F(PythonEmbeddedTest, SessionKeepsNamespaceAcrossRuns) {
+	// Arrange
+	ASSERT_TRUE(runner->openSession("notebook"));
+	runner->runInSession("notebook", "loadExecutionId", "import json\ndata = [arg1] * 3", { 7 }).waitForFinished();
+
+	// Act
+	PythonResult result = runner->runInSession("notebook", "useExecutionId", "print(json.dumps(data))").result();
+	runner->closeSession("notebook");
+	PythonResult closed = runner->runInSession("notebook", "closedExecutionId", "print(data)").result();
+
+	// Assert
+	EXPECT_TRUE(result.isSuccess());
+	EXPECT_EQ(result.getOutput().trimmed(), "[7, 7, 7]");
+	EXPECT_FALSE(closed.isSuccess());
+	EXPECT_EQ(closed.getErrorCode(), static_cast<int>(ExecutionError::Rejected));
+}
+
+TEST_F(PythonEmbeddedTest, IdleSessionIsClosed) {
+	// Arrange
+	QSignalSpy closedSpy(runner.get(), &PythonRunner::sessionClosed);
+	ASSERT_TRUE(runner->openSession("idle", 200));
+	QFuture<PythonResult> run = runner->runInSession("idle", "idleExecutionId", "value = 1");
+
+	// Act
+	QElapsedTimer waited;
+	waited.start();
+	while (closedSpy.isEmpty() && waited.elapsed() < 5000) {
+		QCoreApplication::processEvents(QEventLoop::AllEvents, 50);
+	}
+
+	// Assert: the deadline only starts once the run is done
+	EXPECT_TRUE(run.result().isSuccess());
+	ASSERT_EQ(closedSpy.count(), 1);
+	EXPECT_EQ(closedSpy.first().at(0).toString(), "idle");
+	EXPECT_FALSE(runner->hasSession("idle"));
+}
+
+TEST_F(PythonEmbeddedTest, SessionOverMemoryLimitIsClosed) {
+	// Arrange
+	ASSERT_TRUE(runner->openSession("bounded", -1, 1024 * 1024));
+	runner->runInSession("bounded", "smallExecutionId", "small = list(range(100))").waitForFinished();
+
+	// Act
+	PythonResult result = runner->runInSession("bounded", "largeExecutionId", "large = bytearray(4 * 1024 * 1024)").result();
+	QElapsedTimer waited;
+	waited.start();
+	while (runner->hasSession("bounded") && waited.elapsed() < 5000) {
+		QCoreApplication::processEvents(QEventLoop::AllEvents, 50);
+	}
+
+	// Assert
+	EXPECT_FALSE(result.isSuccess());
+	EXPECT_EQ(result.getErrorCode(), static_cast<int>(ExecutionError::MemoryLimit));
+	EXPECT_FALSE(runner->hasSession("bounded"));
+}
+
+TEST_F(PythonEmbeddedTest, SessionQuotaCountsMemoryOutsideTheNamespace) {
+	// Arrange: memory parked in a module is not referenced by the session's namespace
+	ASSERT_TRUE(memoryQuotasEnabled);
+	ASSERT_TRUE(runner->openSession("hidden", -1, 1024 * 1024));
+
+	// Act
+	PythonResult result = runner->runInSession("hidden", "hiddenExecutionId",
+		"import sys\nsys.modules['embedpython_hidden'] = bytearray(4 * 1024 * 1024)").result();
+
+	// Assert
+	EXPECT_FALSE(result.isSuccess());
+	EXPECT_EQ(result.getErrorCode(), static_cast<int>(ExecutionError::MemoryLimit));
+}
+
+TEST_F(PythonEmbeddedTest, OutputWriterCapturesUnicodeAndLargeOutput) {
+	// Arrange
+	QString script = "import sys\nprint('\u00e4\u20ac\U0001F600')\nsys.stdout.write('x' * 5000000)\nprint('done', file=sys.stderr)";
+
+	// Act
+	PythonResult result = runner->runScriptAsync("writerExecutionId", script).result();
+
+	// Assert
+	EXPECT_TRUE(result.isSuccess());
+	EXPECT_TRUE(result.getOutput().startsWith(QString::fromUtf8("\u00e4\u20ac\U0001F600\n")));
+	EXPECT_EQ(result.getOutput().size(), 5000000 + 5); // The emoji takes two UTF-16 units
+	EXPECT_EQ(result.getErrorOutput().trimmed(), "done");
+}
+
+TEST_F(PythonEmbeddedTest, CancelStopsOnlyTheTargetedExecution) {
+	// Arrange: the victim swallows ordinary exceptions, the bystander has to finish untouched
+	runner->setInterpreterPoolSize(2);
+	QString victimScript = "import time\nwhile True:\n    try:\n        time.sleep(0.01)\n    except Exception:\n        pass";
+	QString bystanderScript = "import time\ntime.sleep(0.5)\nprint('finished')";
+	QFuture<PythonResult> victim = runner->runScriptAsync("victimExecutionId", victimScript);
+	QFuture<PythonResult> bystander = runner->runScriptAsync("bystanderExecutionId", bystanderScript);
+	QThread::msleep(100);
+
+	// Act
+	runner->cancel("victimExecutionId");
+	victim.waitForFinished();
+	bystander.waitForFinished();
+
+	// Assert
+	EXPECT_FALSE(victim.result().isSuccess());
+	EXPECT_EQ(victim.result().getErrorCode(), static_cast<int>(ExecutionError::Cancelled));
+	EXPECT_TRUE(bystander.result().isSuccess());
+	EXPECT_EQ(bystander.result().getOutput().trimmed(), "finished");
+}
+
+TEST_F(PythonEmbeddedTest, TimeoutIsReportedAsTimeout) {
+	// Arrange
+	QFuture<PythonResult> future = runner->runScriptAsync("timeoutExecutionId", "while True:\n    pass", {}, 200);
+
+	// Act
+	QElapsedTimer waited;
+	waited.start();
+	while (!future.isFinished() && waited.elapsed() < 5000) {
+		QCoreApplication::processEvents(QEventLoop::AllEvents, 50);
+	}
+
+	// Assert
+	ASSERT_TRUE(future.isFinished());
+	EXPECT_EQ(future.result().getErrorCode(), static_cast<int>(ExecutionError::Timeout));
+	EXPECT_TRUE(runner->runScriptAsync("afterTimeoutExecutionId", "print(1)").result().isSuccess());
+}
+
+TEST_F(PythonEmbeddedTest, SystemExitEndsOnlyTheScript) {
+	// Act
+	PythonResult clean = runner->runScriptAsync("exitZeroExecutionId", "import sys\nprint('before')\nsys.exit()").result();
+	PythonResult failed = runner->runScriptAsync("exitThreeExecutionId", "import sys\nsys.exit(3)").result();
+	PythonResult message = runner->runScriptAsync("exitMessageExecutionId", "import sys\nsys.exit('bad input')").result();
+
+	// Assert: the host is still running and every exit is reported as the script's own
+	EXPECT_TRUE(clean.isSuccess());
+	EXPECT_EQ(clean.getOutput().trimmed(), "before");
+	EXPECT_FALSE(failed.isSuccess());
+	EXPECT_TRUE(failed.getErrorOutput().contains("code 3"));
+	EXPECT_FALSE(message.isSuccess());
+	EXPECT_TRUE(message.getErrorOutput().contains("bad input"));
+	EXPECT_TRUE(runner->runScriptAsync("afterExitExecutionId", "print(1)").result().isSuccess());
+}
+
+TEST_F(PythonEmbeddedTest, CompiledScriptsAreCached) {
+	// Arrange
+	runner->setInterpreterPoolSize(1);
+	QString script = "print(arg1 * 2)";
+	ASSERT_TRUE(runner->checkSyntax(script).isSuccess());
+	const CodeCacheStats before = runner->codeCacheStats();
+
+	// Act
+	for (int i = 0; i < 5; ++i) {
+		PythonResult result = runner->runScriptAsync(QString("cachedExecutionId%1").arg(i), script, { i }).result();
+		EXPECT_EQ(result.getOutput().trimmed(), QString::number(i * 2));
+	}
+	const CodeCacheStats after = runner->codeCacheStats();
+
+	// Assert: checked once, never compiled again
+	EXPECT_EQ(after.misses, before.misses);
+	EXPECT_EQ(after.hits - before.hits, 5);
+}
+
+TEST_F(PythonEmbeddedTest, CodeCacheEvictsLeastRecentlyUsed) {
+	// Arrange
+	runner->setCodeCacheCapacity(2);
+	const CodeCacheStats before = runner->codeCacheStats();
+
+	// Act
+	for (int i = 0; i < 4; ++i) {
+		runner->checkSyntax(QString("value = %1").arg(i));
+	}
+	const CodeCacheStats after = runner->codeCacheStats();
+
+	// Assert
+	EXPECT_EQ(after.misses - before.misses, 4);
+	EXPECT_EQ(after.evictions - before.evictions, 2);
+}
+
+TEST_F(PythonEmbeddedTest, ExecutorPublishesQueueAndGilMetrics) {
+	// Arrange: one thread, so the later scripts have to queue
+	runner->setInterpreterPoolSize(1);
+	QList<QFuture<PythonResult>> futures;
+
+	// Act
+	for (int i = 0; i < 4; ++i) {
+		futures.append(runner->runScriptAsync(QString("queuedExecutionId%1").arg(i), "import time\ntime.sleep(0.05)"));
+	}
+	for (QFuture<PythonResult>& future : futures) {
+		future.waitForFinished();
+	}
+	const ExecutorStats stats = runner->executorStats();
+
+	// Assert
+	EXPECT_EQ(stats.threads, 1);
+	EXPECT_EQ(stats.queueDepth, 0);
+	EXPECT_GE(stats.peakQueueDepth, 3);
+	EXPECT_GE(stats.startedTasks, 4);
+	EXPECT_GE(stats.maxGilWaitTime, 0);
+	EXPECT_GT(futures.last().result().getQueueDepth(), 0);
+	EXPECT_GE(futures.last().result().getQueueWaitTime(), 100);
+}
+
+TEST_F(PythonEmbeddedTest, MemoryQuotaFailsOnlyTheGreedyExecution) {
+	// Arrange
+	if (!memoryQuotasEnabled) {
+		GTEST_SKIP() << "Memory quotas are not supported by this Python build.";
+	}
+	runner->setInterpreterPoolSize(2);
+	ExecutionLimits limits;
+	limits.memoryBytes = 64 * 1024 * 1024;
+
+	// Act
+	QFuture<PythonResult> greedy = runner->runScriptAsync("greedyExecutionId", "data = []\nwhile True:\n    data.append(bytearray(1024 * 1024))", {}, 0, limits);
+	QFuture<PythonResult> modest = runner->runScriptAsync("modestExecutionId", "data = bytearray(8 * 1024 * 1024)\nprint(len(data))", {}, 0, limits);
+
+	// Assert
+	EXPECT_FALSE(greedy.result().isSuccess());
+	EXPECT_EQ(greedy.result().getErrorCode(), static_cast<int>(ExecutionError::MemoryLimit));
+	EXPECT_TRUE(greedy.result().getErrorOutput().contains("MemoryError"));
+	EXPECT_TRUE(modest.result().isSuccess());
+	EXPECT_GE(modest.result().getResourceUsage().peakAllocatedBytes, 8 * 1024 * 1024);
+	EXPECT_LE(modest.result().getResourceUsage().peakAllocatedBytes, limits.memoryBytes);
+}
+
+TEST_F(PythonEmbeddedTest, ProfiledExecutionReportsCollapsedStacks) {
+	// Arrange
+	runner->setProfiling(1.0, 5);
+	QString script = "def busy():\n    total = 0\n    for i in range(3000000):\n        total += i\n    return total\nprint(busy())";
+
+	// Act
+	PythonResult result = runner->runScriptAsync("profiledExecutionId", script).result();
+
+	// Assert: every line is "<module> (...);busy (...) <count>"
+	EXPECT_TRUE(result.isSuccess());
+#ifndef Py_GIL_DISABLED
+	const QStringList lines = result.getProfile().split('\n', Qt::SkipEmptyParts);
+	ASSERT_FALSE(lines.isEmpty());
+	EXPECT_TRUE(lines.first().contains("busy ("));
+	EXPECT_GT(lines.first().section(' ', -1).toInt(), 0);
+#endif
+
+	runner->setProfiling(0);
+	EXPECT_TRUE(runner->runScriptAsync("unprofiledExecutionId", "print(1)").result().getProfile().isEmpty());
+}
+
+TEST_F(PythonEmbeddedTest, LineBudgetIsDeterministic) {
+	// Arrange: the script catches everything it can, the budget still stops it
+	runner->setExecutionBudget(1000);
+	QString endless = "while True:\n    try:\n        pass\n    except BaseException:\n        pass";
+	QString bounded = "total = 0\nfor i in range(100):\n    total += i\nprint(total)";
+
+	// Act
+	PythonResult stopped = runner->runScriptAsync("endlessExecutionId", endless).result();
+	PythonResult first = runner->runScriptAsync("boundedExecutionId1", bounded).result();
+	PythonResult second = runner->runScriptAsync("boundedExecutionId2", bounded).result();
+
+	// Assert
+	EXPECT_FALSE(stopped.isSuccess());
+	EXPECT_EQ(stopped.getErrorCode(), static_cast<int>(ExecutionError::BudgetExceeded));
+	EXPECT_TRUE(stopped.getErrorOutput().contains("BudgetExceeded"));
+	EXPECT_TRUE(first.isSuccess());
+	EXPECT_GT(first.getResourceUsage().executedUnits, 100);
+	EXPECT_EQ(first.getResourceUsage().executedUnits, second.getResourceUsage().executedUnits);
+}
+
+TEST_F(PythonEmbeddedTest, NumericArgumentIsPassedWithoutCopying) {
+	// Arrange: 100 MB of doubles
+	QList<double> samples(100 * 1024 * 1024 / sizeof(double), 0.25);
+	QString script = "view = memoryview(arg1)\nprint(view.format, view.readonly, len(view), view[0] + view[-1])";
+
+	// Act
+	QElapsedTimer timer;
+	timer.start();
+	PythonResult result = runner->runScriptAsync("bufferExecutionId", script, { QVariant::fromValue(samples) }).result();
+	const qint64 elapsed = timer.elapsed();
+
+	// Assert
+	EXPECT_TRUE(result.isSuccess());
+	EXPECT_EQ(result.getOutput().trimmed(), QString("d True %1 0.5").arg(samples.size()));
+	EXPECT_LT(elapsed, 1000);
+}
+
+TEST_F(PythonEmbeddedTest, ScriptHandsBackTypedResultBuffer) {
+	// Arrange
+	QString script = "import array, embedpython\nembedpython.set_result(array.array('d', (i / 2 for i in range(1000))))";
+
+	// Act
+	PythonResult result = runner->runScriptAsync("resultBufferExecutionId", script).result();
+	PythonResult plain = runner->runScriptAsync("plainExecutionId", "print(1)").result();
+
+	// Assert
+	EXPECT_TRUE(result.isSuccess());
+	ASSERT_TRUE(result.hasResultBuffer());
+	const NumericBuffer buffer = result.getResultBuffer();
+	ASSERT_NE(buffer.data<double>(), nullptr);
+	EXPECT_EQ(buffer.count(), 1000);
+	EXPECT_DOUBLE_EQ(buffer.data<double>()[999], 499.5);
+	EXPECT_TRUE(result.getOutput().isEmpty());
+	EXPECT_FALSE(plain.hasResultBuffer());
+}